@@ -1,9 +1,12 @@
 #include <fiberize/fiberize.hpp>
 #include <iostream>
+#include <chrono>
 
 using namespace fiberize;
 
 const uint n = 10000;
+const int messages = 100000;
+const int latencyRoundTrips = 1000000;
 
 Event<FiberRef> ping;
 Event<void> pong;
@@ -40,7 +43,7 @@ struct Emitter {
             sent += 1;
         }
 
-        handlePong = pong.bind([=] () {
+        handlePong = pong.bind([this, echo, self] () {
             received += 1;
 
             if (sent < repeat) {
@@ -57,17 +60,38 @@ struct Emitter {
     }
 };
 
+template <typename Body>
+double measure(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
 int main() {
     FiberSystem system;
     FiberRef self = system.fiberize();
 
-    auto emitter = system.actor(Emitter{self, 100, 100000});
-    for (uint i = 0; i < n; ++i) {
+    // A single pair of actors with one message in flight measures the round-trip latency.
+    double latency = measure([&] () {
         auto echoRef = system.actor(Echo{}).run();
-        emitter.copy().run_(echoRef);
-    }
-
-    for (uint i = 0; i < n; ++i)
+        system.actor(Emitter{self, 1, latencyRoundTrips}).run_(echoRef);
         finished.await();
+    });
+
+    // Many pairs with many messages in flight measure the throughput.
+    double throughput = measure([&] () {
+        auto emitter = system.actor(Emitter{self, 100, messages});
+        for (uint i = 0; i < n; ++i) {
+            auto echoRef = system.actor(Echo{}).run();
+            emitter.copy().run_(echoRef);
+        }
+
+        for (uint i = 0; i < n; ++i)
+            finished.await();
+    });
+
+    std::cout << "round trip: " << latency / latencyRoundTrips * 1e9 << " ns" << std::endl;
+    std::cout << "throughput: " << uint64_t(2.0 * n * messages / throughput) << " messages/s" << std::endl;
     return 0;
 }
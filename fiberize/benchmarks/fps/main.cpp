@@ -1,5 +1,7 @@
 #include <fiberize/fiberize.hpp>
 #include <iostream>
+#include <map>
+#include <string>
 
 using namespace fiberize;
 
@@ -18,8 +20,30 @@ void fiber(size_t i) {
     }
 }
 
-int main() {
-    FiberSystem system;
+/**
+ * Spawns lines of fibers, each spawning the next one. The optional argument chooses the placement
+ * of new fibers: local, roundrobin, leastloaded or hashed.
+ */
+int main(int argc, char** argv) {
+    const std::map<std::string, Placement> placements = {
+        {"local", Placement::Local},
+        {"roundrobin", Placement::RoundRobin},
+        {"leastloaded", Placement::LeastLoaded},
+        {"hashed", Placement::Hashed}
+    };
+
+    FiberSystemConfig config;
+    config.preemption = Preemption::Disabled;
+    if (argc > 1) {
+        auto it = placements.find(argv[1]);
+        if (it == placements.end()) {
+            std::cerr << "unknown placement: " << argv[1] << std::endl;
+            return 1;
+        }
+        config.placement = it->second;
+    }
+
+    FiberSystem system(config);
     mainThread = system.fiberize();
 
     for (size_t i = 0; i < lines; ++i) {
@@ -0,0 +1,76 @@
+#include <fiberize/fiberize.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace fiberize;
+using namespace std::literals;
+
+/**
+ * Size of the buffer each fiber keeps on its stack while parked, like a connection would.
+ */
+const size_t bufferSize = 2048;
+
+Event<void> go;
+
+/**
+ * Resident set size of this process in bytes.
+ */
+size_t residentSize() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    statm >> total >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char** argv) {
+    size_t fibers = 100000;
+    if (argc > 1)
+        fibers = std::stoul(argv[1]);
+
+    FiberSystemConfig config;
+    // Every guarded stack takes two mappings, there are too many fibers for the kernel's limit.
+    config.stackGuardPages = false;
+    config.preemption = Preemption::Disabled;
+    FiberSystem system(config);
+    system.fiberize();
+
+    size_t before = residentSize();
+
+    std::atomic<size_t> parked(0);
+    auto sleeper = system.future([&parked] () {
+        volatile char buffer[bufferSize];
+        for (size_t i = 0; i < bufferSize; i += 64) {
+            buffer[i] = i;
+        }
+        parked += 1;
+        go.await();
+        return buffer[0];
+    });
+
+    std::vector<FutureRef<char>> refs;
+    for (size_t i = 0; i < fibers; ++i) {
+        refs.push_back(sleeper.copy().run());
+    }
+    while (parked < fibers) {
+        std::this_thread::sleep_for(10ms);
+    }
+    std::this_thread::sleep_for(1s);
+
+    size_t after = residentSize();
+    std::cout << "fibers\tRSS per parked fiber" << std::endl;
+    std::cout << fibers << "\t" << (after - before) / fibers << " bytes" << std::endl;
+
+    for (FutureRef<char>& ref : refs) {
+        ref.send(go);
+    }
+    for (FutureRef<char>& ref : refs) {
+        ref.await();
+    }
+
+    return 0;
+}
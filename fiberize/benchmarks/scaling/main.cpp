@@ -0,0 +1,96 @@
+#include <fiberize/fiberize.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+using namespace fiberize;
+
+const size_t fibersPerLine = 100 * 1000;
+const size_t lines = 100;
+
+const size_t actors = 1000;
+const size_t messagesPerActor = 1000;
+
+Event<void> finished;
+Event<FiberRef> ping;
+Event<void> pong;
+
+FiberRef mainThread;
+
+void fiber(size_t i) {
+    if (i == fibersPerLine) {
+        mainThread.send(finished);
+    } else {
+        context::system()->fiber(fiber).run_(i+1);
+    }
+}
+
+struct Echo {
+    HandlerRef handlePing;
+
+    void operator () () {
+        handlePing = ping.bind([] (const FiberRef& sender) {
+            sender.send(pong);
+        });
+    }
+};
+
+void emitter(FiberRef echo) {
+    FiberRef self = context::self();
+    for (size_t i = 0; i < messagesPerActor; ++i) {
+        echo.send(ping, self);
+        pong.await();
+    }
+    echo.kill();
+    mainThread.send(finished);
+}
+
+template <typename Body>
+double measure(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Runs the fps and echo workloads with 1 to N macrothreads. Uses only the public API,
+ * so it can be built against older versions of the scheduler for comparison.
+ */
+int main(int argc, char** argv) {
+    uint32_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1)
+        maxThreads = std::stoul(argv[1]);
+
+    std::cout << "threads\tfibers/s\tmessages/s" << std::endl;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+        FiberSystem system(threads);
+        mainThread = system.fiberize();
+
+        double fps = measure([&] () {
+            for (size_t i = 0; i < lines; ++i) {
+                system.fiber(fiber).run_(1);
+            }
+            for (size_t i = 0; i < lines; ++i) {
+                finished.await();
+            }
+        });
+
+        double echo = measure([&] () {
+            for (size_t i = 0; i < actors; ++i) {
+                auto echoRef = system.actor(Echo{}).run();
+                system.fiber(emitter).run_(echoRef);
+            }
+            for (size_t i = 0; i < actors; ++i) {
+                finished.await();
+            }
+        });
+
+        std::cout << threads
+            << "\t" << uint64_t(fibersPerLine * lines / fps)
+            << "\t" << uint64_t(2 * actors * messagesPerActor / echo)
+            << std::endl;
+    }
+
+    return 0;
+}
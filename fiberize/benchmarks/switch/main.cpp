@@ -0,0 +1,110 @@
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/context.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace fiberize;
+
+const size_t stackSize = 64 * 1024;
+
+size_t switches = 10000000;
+
+detail::Context mainContext;
+detail::Context fiberContext;
+bool restoreFpu;
+
+boost::context::fcontext_t boostMainContext;
+boost::context::fcontext_t boostFiberContext;
+
+void pingPong(intptr_t) {
+    for (;;) {
+        detail::jumpContext(&fiberContext, mainContext, 0, restoreFpu);
+    }
+}
+
+void boostPingPong(intptr_t) {
+    for (;;) {
+        boost::context::jump_fcontext(&boostFiberContext, boostMainContext, 0, true);
+    }
+}
+
+/**
+ * Nanoseconds per switch between two contexts, without the scheduler.
+ */
+double rawSwitch(bool restore) {
+    std::unique_ptr<char[]> stack(new char[stackSize]);
+    restoreFpu = restore;
+    fiberContext = detail::makeContext(stack.get() + stackSize, stackSize, pingPong);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < switches; ++i) {
+        detail::jumpContext(&mainContext, fiberContext, 0, restore);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (2 * switches);
+}
+
+/**
+ * Nanoseconds per switch with Boost.Context, saving the floating point state.
+ */
+double boostSwitch() {
+    std::unique_ptr<char[]> stack(new char[stackSize]);
+    boostFiberContext = boost::context::make_fcontext(stack.get() + stackSize, stackSize, boostPingPong);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < switches; ++i) {
+        boost::context::jump_fcontext(&boostMainContext, boostFiberContext, 0, true);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (2 * switches);
+}
+
+/**
+ * Nanoseconds per switch between two fibers yielding to each other on one macrothread.
+ */
+double fiberSwitch(bool integerOnly) {
+    FiberSystemConfig config;
+    config.macrothreads = 1;
+    config.preemption = Preemption::Disabled;
+    FiberSystem system(config);
+    system.fiberize();
+
+    size_t yields = switches / 2;
+    auto yielder = system.future([yields] () {
+        for (size_t i = 0; i < yields; ++i) {
+            context::yield();
+        }
+    });
+    if (integerOnly)
+        yielder.integerOnly();
+
+    auto start = std::chrono::steady_clock::now();
+    auto first = yielder.copy().run();
+    auto second = yielder.copy().run();
+    first.await();
+    second.await();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (2 * yields);
+}
+
+/**
+ * Measures the cost of a context switch, raw and through the scheduler.
+ */
+int main(int argc, char** argv) {
+    if (argc > 1)
+        switches = std::stoul(argv[1]);
+
+#ifdef FIBERIZE_INTREE_CONTEXT
+    std::cout << "context switch: in-tree" << std::endl;
+#else
+    std::cout << "context switch: Boost.Context" << std::endl;
+#endif
+    std::cout << "raw, Boost.Context jump_fcontext:\t" << boostSwitch() << " ns" << std::endl;
+    std::cout << "raw, restoring the FPU state:\t\t" << rawSwitch(true) << " ns" << std::endl;
+    std::cout << "raw, skipping the FPU state:\t\t" << rawSwitch(false) << " ns" << std::endl;
+    std::cout << "fibers, yielding:\t\t\t" << fiberSwitch(false) << " ns" << std::endl;
+    std::cout << "fibers, yielding, integer only:\t\t" << fiberSwitch(true) << " ns" << std::endl;
+    return 0;
+}
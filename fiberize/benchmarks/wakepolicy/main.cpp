@@ -0,0 +1,168 @@
+#include <fiberize/fiberize.hpp>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace fiberize;
+
+const size_t rings = 16;
+const size_t stagesPerRing = 64;
+const size_t tokensPerRing = 4;
+const size_t hopsPerToken = 20 * 1000;
+
+const size_t workers = 256;
+const size_t requestsPerWorker = 2000;
+
+/**
+ * Size of the state touched by an actor on every message, in 64 bit words.
+ */
+const size_t stateWords = 512;
+
+Event<FiberRef> nextStage;
+Event<uint64_t> token;
+Event<FiberRef> request;
+Event<void> reply;
+Event<void> finished;
+
+FiberRef mainThread;
+
+/**
+ * Touches the whole state, so an actor running on a cold cache pays for it.
+ */
+uint64_t touch(std::vector<uint64_t>& state) {
+    uint64_t sum = 0;
+    for (uint64_t& word : state) {
+        word += 1;
+        sum += word;
+    }
+    return sum;
+}
+
+/**
+ * A stage of a ring, passing tokens to the next one.
+ */
+struct Stage {
+    std::vector<uint64_t> state;
+    FiberRef next;
+    HandlerRef handleLink;
+    HandlerRef handleToken;
+
+    void operator () () {
+        state.resize(stateWords);
+        handleLink = nextStage.bind([this] (const FiberRef& ref) {
+            next = ref;
+        });
+        handleToken = token.bind([this] (uint64_t hops) {
+            touch(state);
+            if (hops == 0) {
+                mainThread.send(finished);
+            } else {
+                next.send(token, hops - 1);
+            }
+        });
+    }
+};
+
+/**
+ * A worker answering requests.
+ */
+struct Worker {
+    std::vector<uint64_t> state;
+    HandlerRef handleRequest;
+
+    void operator () () {
+        state.resize(stateWords);
+        handleRequest = request.bind([this] (const FiberRef& sender) {
+            touch(state);
+            sender.send(reply);
+        });
+    }
+};
+
+void client(FiberRef worker) {
+    FiberRef self = context::self();
+    for (size_t i = 0; i < requestsPerWorker; ++i) {
+        worker.send(request, self);
+        reply.await();
+    }
+    worker.kill();
+    mainThread.send(finished);
+}
+
+template <typename Body>
+double measure(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/**
+ * Compares the wake policies on actor workloads: tokens passed around rings of actors
+ * and clients talking to their own workers. Every actor touches its state on each message.
+ */
+int main(int argc, char** argv) {
+    uint32_t threads = std::thread::hardware_concurrency();
+    if (argc > 1)
+        threads = std::stoul(argv[1]);
+
+    std::vector<std::pair<const char*, WakePolicy>> policies = {
+        {"local", WakePolicy::Local},
+        {"random", WakePolicy::Random},
+        {"last", WakePolicy::Last}
+    };
+
+    std::cout << "policy\tring messages/s\tworker messages/s" << std::endl;
+    for (const auto& policy : policies) {
+        FiberSystemConfig config;
+        config.macrothreads = threads;
+        config.wakePolicy = policy.second;
+        config.preemption = Preemption::Disabled;
+        FiberSystem system(config);
+        mainThread = system.fiberize();
+
+        std::vector<FiberRef> stages;
+        for (size_t i = 0; i < rings * stagesPerRing; ++i) {
+            stages.push_back(system.actor(Stage{}).run());
+        }
+        for (size_t ring = 0; ring < rings; ++ring) {
+            for (size_t i = 0; i < stagesPerRing; ++i) {
+                size_t next = ring * stagesPerRing + (i + 1) % stagesPerRing;
+                stages[ring * stagesPerRing + i].send(nextStage, stages[next]);
+            }
+        }
+
+        double ring = measure([&] () {
+            for (size_t ring = 0; ring < rings; ++ring) {
+                for (size_t i = 0; i < tokensPerRing; ++i) {
+                    stages[ring * stagesPerRing + i * stagesPerRing / tokensPerRing].send(token, hopsPerToken);
+                }
+            }
+            for (size_t i = 0; i < rings * tokensPerRing; ++i) {
+                finished.await();
+            }
+        });
+
+        for (FiberRef& stage : stages) {
+            stage.kill();
+        }
+
+        double worker = measure([&] () {
+            for (size_t i = 0; i < workers; ++i) {
+                auto workerRef = system.actor(Worker{}).run();
+                system.fiber(client).run_(workerRef);
+            }
+            for (size_t i = 0; i < workers; ++i) {
+                finished.await();
+            }
+        });
+
+        std::cout << policy.first
+            << "\t" << uint64_t(rings * tokensPerRing * (hopsPerToken + 1) / ring)
+            << "\t" << uint64_t(2 * workers * requestsPerWorker / worker)
+            << std::endl;
+    }
+
+    return 0;
+}
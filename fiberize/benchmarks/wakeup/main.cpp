@@ -0,0 +1,80 @@
+#include <fiberize/fiberize.hpp>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace fiberize;
+using namespace std::literals;
+
+const size_t pings = 1000;
+const auto gap = 2ms;
+const auto idlePeriod = 1s;
+
+Event<FiberRef> ping;
+Event<void> pong;
+
+struct Echo {
+    HandlerRef handlePing;
+
+    void operator () () {
+        handlePing = ping.bind([] (const FiberRef& sender) {
+            sender.send(pong);
+        });
+    }
+};
+
+double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Measures how long it takes an idle system to pick up a message and how much CPU
+ * the idle schedulers burn.
+ */
+int main(int argc, char** argv) {
+    uint32_t threads = std::thread::hardware_concurrency();
+    if (argc > 1)
+        threads = std::stoul(argv[1]);
+
+    FiberSystem system(threads);
+    FiberRef self = system.fiberize();
+    FiberRef echo = system.actor(Echo{}).run();
+
+    // Round trips starting from an idle system.
+    std::vector<double> latencies;
+    for (size_t i = 0; i < pings; ++i) {
+        std::this_thread::sleep_for(gap);
+        auto start = std::chrono::steady_clock::now();
+        echo.send(ping, self);
+        pong.await();
+        auto end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double sum = 0;
+    for (double latency : latencies)
+        sum += latency;
+
+    std::cout << "wakeup latency (us): mean " << sum / latencies.size()
+        << ", p50 " << latencies[latencies.size() / 2]
+        << ", p99 " << latencies[latencies.size() * 99 / 100]
+        << ", max " << latencies.back() << std::endl;
+
+    // CPU used while nothing happens.
+    double before = cpuSeconds();
+    std::this_thread::sleep_for(idlePeriod);
+    double after = cpuSeconds();
+    std::cout << "idle cpu: " << 100 * (after - before) / std::chrono::duration<double>(idlePeriod).count()
+        << "% of one core with " << threads << " threads" << std::endl;
+
+    echo.kill();
+    return 0;
+}
@@ -29,20 +29,36 @@ auto Builder<TaskTraits, Entity, MailboxType>::run(Args&&... args) -> typename T
 
     FiberSystem* system = Scheduler::current()->system();
     if (!system->shuttingDown()) {
+        /**
+         * Look up the pool and the shard first, an unknown one throws before anything is created.
+         */
+        detail::SchedulerPool* pool = pool_ ? system->pool(pool_.get()) : nullptr;
+        Scheduler* pin = shard_ ? system->shard(shard_.get()) : pin_;
+
         /**
          * Create the task
          */
         Path path = PrefixedPath(system->uuid(), ident());
         std::unique_ptr<Mailbox> mailbox(new MailboxType(std::move(mailbox_)));
-        auto task = Traits::newTask(std::move(path), std::move(mailbox), pin_,
+        auto task = Traits::newTask(std::move(path), std::move(mailbox), pin,
             detail::bind<Entity, Args...>(std::move(task_), std::forward<Args>(args)...));
+        task->priority = priority_;
+        task->preferred = preferred_;
+        task->pool = pool;
+        task->stackSize = stackSize_;
+        task->integerOnly = integerOnly_;
+        task->nonBlockingHandlers = nonBlockingHandlers_;
+        if (deadline_) {
+            task->baseDeadline = detail::deadlineValue(deadline_.get());
+            task->deadline = task->baseDeadline;
+        }
 
         /**
          * Create the reference BEFORE starting the task. Otherwise the task could complete
          * before we can increment the refernce counter.
          */
         auto ref = Traits::localRef(system, task);
-        runner_(task);
+        runner_(task, placement_.get_value_or(system->config().placement));
         return ref;
     } else {
         return Traits::devNullRef();
@@ -58,14 +74,30 @@ void Builder<TaskTraits, Entity, MailboxType>::run_(Args&&... args) {
 
     FiberSystem* system = Scheduler::current()->system();
     if (!system->shuttingDown()) {
+        /**
+         * Look up the pool and the shard first, an unknown one throws before anything is created.
+         */
+        detail::SchedulerPool* pool = pool_ ? system->pool(pool_.get()) : nullptr;
+        Scheduler* pin = shard_ ? system->shard(shard_.get()) : pin_;
+
         /**
          * Create and schedule the task
          */
         Path path = PrefixedPath(system->uuid(), ident());
         std::unique_ptr<Mailbox> mailbox(new MailboxType(std::move(mailbox_)));
-        auto task = Traits::newTask(std::move(path), std::move(mailbox), pin_,
+        auto task = Traits::newTask(std::move(path), std::move(mailbox), pin,
             detail::bind<Entity, Args...>(std::move(task_), std::forward<Args>(args)...));
-        runner_(task);
+        task->priority = priority_;
+        task->preferred = preferred_;
+        task->pool = pool;
+        task->stackSize = stackSize_;
+        task->integerOnly = integerOnly_;
+        task->nonBlockingHandlers = nonBlockingHandlers_;
+        if (deadline_) {
+            task->baseDeadline = detail::deadlineValue(deadline_.get());
+            task->deadline = task->baseDeadline;
+        }
+        runner_(task, placement_.get_value_or(system->config().placement));
     }
 }
 
@@ -11,6 +11,8 @@
 #include <boost/optional.hpp>
 
 #include <fiberize/path.hpp>
+#include <fiberize/placement.hpp>
+#include <fiberize/priority.hpp>
 #include <fiberize/scheduler.hpp>
 #include <fiberize/detail/runner.hpp>
 
@@ -35,12 +37,21 @@ private:
         TaskType task,
         MailboxType mailbox,
         Scheduler* pin,
-        void (*runner)(detail::Task*))
+        void (*runner)(detail::Task*, Placement))
         : invalidated(false)
         , name_(std::move(name))
         , task_(std::move(task))
         , mailbox_(std::move(mailbox))
         , pin_(pin)
+        , preferred_(nullptr)
+        , priority_(Priority::Normal)
+        , deadline_(boost::none)
+        , placement_(boost::none)
+        , pool_(boost::none)
+        , shard_(boost::none)
+        , stackSize_(0)
+        , integerOnly_(false)
+        , nonBlockingHandlers_(false)
         , runner_(runner)
         {}
 
@@ -90,7 +101,7 @@ public:
     /**
      * The name of the entities built by this builder, if they are named.
      */
-    boost::optional<std::string>& name() const {
+    boost::optional<std::string>& name() {
         assert(!invalidated);
         return name_;
     }
@@ -98,7 +109,7 @@ public:
     /**
      * Returns the task.
      */
-    TaskType& task() const {
+    TaskType& task() {
         assert(!invalidated);
         return task_;
     }
@@ -106,7 +117,7 @@ public:
     /**
      * Returns the mailbox.
      */
-    MailboxType& mailbox() const {
+    MailboxType& mailbox() {
         assert(!invalidated);
         return mailbox_;
     }
@@ -114,11 +125,19 @@ public:
     /**
      * Scheduler the entities built by this builder are pinned to.
      */
-    Scheduler*& pin() const {
+    Scheduler*& pin() {
         assert(!invalidated);
         return pin_;
     }
 
+    /**
+     * Priority class of the entities built by this builder.
+     */
+    Priority priority() const {
+        assert(!invalidated);
+        return priority_;
+    }
+
     ///@}
 
     /**
@@ -148,18 +167,50 @@ public:
 
     /**
      * Unpins the task.
-     * @note This is the default.
+     * @note This is the default. In a sharded system unpinned tasks are pinned to the shard that starts them.
      */
-    Builder& detached() const {
+    Builder& detached() {
         assert(!invalidated);
         pin_ = nullptr;
         return *this;
     }
 
+    /**
+     * Pins the task to the given shard of a sharded system.
+     * @note Starting the task throws std::out_of_range if there is no such shard.
+     * @see FiberSystem::shardOf
+     */
+    Builder& onShard(uint32_t shard) {
+        assert(!invalidated);
+        shard_ = shard;
+        return *this;
+    }
+
+    /**
+     * Makes the task prefer the currently running scheduler.
+     */
+    Builder& preferred() {
+        assert(!invalidated);
+        preferred_ = Scheduler::current();
+        return *this;
+    }
+
+    /**
+     * Makes the task prefer the given scheduler. The task is queued on that scheduler whenever
+     * it is resumed, but other schedulers can still take it after it waited for
+     * FiberSystemConfig::preferredStealDelay or when too many tasks are waiting.
+     * @note The preference has no effect on pinned tasks.
+     */
+    Builder& preferred(Scheduler* scheduler) {
+        assert(!invalidated);
+        preferred_ = scheduler;
+        return *this;
+    }
+
     /**
      * Names the task.
      */
-    Builder& named(std::string name) const {
+    Builder& named(std::string name) {
         assert(!invalidated);
         name_ = name;
         return *this;
@@ -169,12 +220,89 @@ public:
      * Makes the task unnamed.
      * @note This is the default.
      */
-    Builder& unnamed() const {
+    Builder& unnamed() {
         assert(!invalidated);
         name_ = boost::none;
         return *this;
     }
 
+    /**
+     * Sets the priority class of the task.
+     * @note The default is Priority::Normal.
+     */
+    Builder& priority(Priority priority) {
+        assert(!invalidated);
+        priority_ = priority;
+        return *this;
+    }
+
+    /**
+     * Sets the deadline of the task. Tasks with a deadline are scheduled earliest deadline first.
+     */
+    Builder& deadline(Deadline deadline) {
+        assert(!invalidated);
+        deadline_ = deadline;
+        return *this;
+    }
+
+    /**
+     * Runs the task in the named pool of macrothreads.
+     * @note The default is the default pool. Starting the task throws UnknownPool if the pool doesn't exist.
+     */
+    Builder& inPool(std::string pool) {
+        assert(!invalidated);
+        pool_ = std::move(pool);
+        return *this;
+    }
+
+    /**
+     * Sets the size of the stack the task runs on, in bytes. Stacks come in size classes, the size is
+     * rounded up to a power of two between 16KB and 16MB.
+     * @note The default is the default size of Boost.Context. Has no effect on OS threads.
+     */
+    Builder& stackSize(size_t bytes) {
+        assert(!invalidated);
+        stackSize_ = bytes;
+        return *this;
+    }
+
+    /**
+     * Promises that the task doesn't change the floating point control registers (the rounding mode
+     * and the exception masks), so that switching to and from it can skip restoring them.
+     * @note The default is to restore them. Has no effect on OS threads.
+     */
+    Builder& integerOnly() {
+        assert(!invalidated);
+        integerOnly_ = true;
+        return *this;
+    }
+
+    /**
+     * Promises that the event handlers of the actor never suspend: they don't await, yield or sleep.
+     * The actor then processes its events right on the stack of the scheduler, or on the rest of the
+     * stack of the task that just suspended, instead of taking a stack of its own. Handlers get at
+     * least half of the stack size the actor asks for. Blocking calls made by the handlers don't
+     * hand the scheduler over and preemption is ignored.
+     * @note The default is to run the handlers on a stack of their own. Suspending in a handler
+     *       fails an assertion. Has no effect on OS threads.
+     */
+    Builder& nonBlockingHandlers() {
+        assert(!invalidated);
+        nonBlockingHandlers_ = true;
+        return *this;
+    }
+
+    /**
+     * Chooses the macrothread the task is queued on when it starts.
+     * @note The default is FiberSystemConfig::placement. Has no effect on pinned tasks and tasks
+     *       preferring a scheduler.
+     */
+    Builder& placement(Placement placement) {
+        assert(!invalidated);
+        placement_ = placement;
+        return *this;
+    }
+
     /**
      * Configures the task to execute as a microthread.
      * @note This is the default.
@@ -232,7 +360,7 @@ private:
      * @warning Moves the name.
      * @internal
      */
-    Ident ident() const {
+    Ident ident() {
         if (name_.is_initialized()) {
             return std::move(name_.get());
         } else {
@@ -244,8 +372,17 @@ private:
     boost::optional<std::string> name_;
     TaskType task_;
     MailboxType mailbox_;
-    Scheduler* const pin_;
-    void (*runner_)(detail::Task*);
+    Scheduler* pin_;
+    Scheduler* preferred_;
+    Priority priority_;
+    boost::optional<Deadline> deadline_;
+    boost::optional<Placement> placement_;
+    boost::optional<std::string> pool_;
+    boost::optional<uint32_t> shard_;
+    size_t stackSize_;
+    bool integerOnly_;
+    bool nonBlockingHandlers_;
+    void (*runner_)(detail::Task*, Placement);
 };
 
 } // namespace fiberize
@@ -34,6 +34,27 @@ public:
      */
     void await(std::unique_lock<Spinlock>& lock);
 
+    /**
+     * Makes the condition resume the current task when it is signaled, without suspending the task.
+     * Used by tasks that can't suspend, like coroutines, which have to check on their own whether
+     * they were signaled.
+     * @returns the ticket of the task, signaled(ticket) tells when it's released.
+     */
+    uint64_t subscribe(std::unique_lock<Spinlock>& lock);
+
+    /**
+     * Whether the task holding the given ticket was released.
+     */
+    bool signaled(uint64_t ticket) const {
+        return released.load(std::memory_order_acquire) >= ticket;
+    }
+
+    /**
+     * Withdraws the given ticket, if it wasn't released yet.
+     * @returns whether the ticket was withdrawn.
+     */
+    bool unsubscribe(uint64_t ticket, std::unique_lock<Spinlock>& lock);
+
     /**
      * Wake up one thread waiting on the condition.
      */
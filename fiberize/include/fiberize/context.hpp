@@ -7,9 +7,11 @@
 #ifndef FIBERIZE_CONTEXT_HPP
 #define FIBERIZE_CONTEXT_HPP
 
+#include <atomic>
 #include <mutex>
 
 #include <fiberize/fiberref.hpp>
+#include <fiberize/result.hpp>
 #include <fiberize/spinlock.hpp>
 
 namespace fiberize {
@@ -53,6 +55,20 @@ std::mt19937_64& random();
  */
 void yield();
 
+/**
+ * Yields if the fiber has been running for longer than its time slice. Long computations should
+ * call it periodically. Sending and processing events does it automatically.
+ */
+inline void checkpoint();
+
+/**
+ * Executes a blocking call, for example a synchronous syscall or a third-party library. If the call
+ * takes long and FiberSystemConfig::blockingHandoff is enabled, the scheduler is handed over to
+ * another thread so that the other fibers keep running. The fiber might continue on a different thread afterwards. The call must not use fiberize.
+ */
+template <typename Function>
+auto blocking(Function&& function) -> decltype(function());
+
 /**
  * Stop the actor.
  */
@@ -86,6 +102,12 @@ namespace detail {
  */
 void process(std::unique_lock<Spinlock>& lock);
 
+/**
+ * Processes all pending events of a listening task, or runs a coroutine task up to its next
+ * suspension point. Like process() the lock is released while the task runs.
+ */
+void advance(std::unique_lock<Spinlock>& lock);
+
 /**
  * Returns the currently running task.
  */
@@ -116,8 +138,58 @@ void resume(fiberize::detail::Task* task);
  */
 void resume(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock);
 
+/**
+ * Resumes execution of a suspended task. If possible, switches to it immediately and reschedules the
+ * current task.
+ */
+void resumeAndSwitch(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock);
+
+/**
+ * Resumes execution of a task that received an event due by the given deadline. If the task already
+ * waits in a queue ordered by a later deadline or by its priority, it is queued again by the new one.
+ */
+void resumeWithDeadline(fiberize::detail::Task* task, uint64_t deadline, std::unique_lock<Spinlock> lock);
+
+/**
+ * Set when the current thread should yield at the next safepoint.
+ */
+extern thread_local std::atomic<bool> preemptRequested;
+
+/**
+ * Yields the current task if it exceeded its time slice.
+ */
+void preempt();
+
+/**
+ * Allows the scheduler to be handed over during a blocking call.
+ * @returns whether leaveBlocking() has to be called afterwards.
+ */
+bool enterBlocking();
+
+/**
+ * Ends a blocking call, rescheduling the fiber if the scheduler was handed over.
+ */
+void leaveBlocking();
+
 } // namespace detail
 
+inline void checkpoint() {
+    if (detail::preemptRequested.load(std::memory_order_relaxed))
+        detail::preempt();
+}
+
+template <typename Function>
+auto blocking(Function&& function) -> decltype(function()) {
+    bool entered = detail::enterBlocking();
+
+    // An exception must not be in flight when the fiber switches threads, catch it and rethrow later.
+    auto value = result(function);
+
+    if (entered)
+        detail::leaveBlocking();
+    return value.get();
+}
+
 ///@}
 
 } // namespace context
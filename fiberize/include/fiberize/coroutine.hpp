@@ -0,0 +1,378 @@
+/**
+ * Stackless tasks based on C++20 coroutines.
+ *
+ * @file coroutine.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_COROUTINE_HPP
+#define FIBERIZE_COROUTINE_HPP
+
+#ifdef FIBERIZE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include <boost/optional.hpp>
+
+#include <fiberize/context.hpp>
+#include <fiberize/event.hpp>
+#include <fiberize/fiberref.hpp>
+#include <fiberize/handler.hpp>
+#include <fiberize/promise.hpp>
+#include <fiberize/result.hpp>
+#include <fiberize/detail/runnable.hpp>
+#include <fiberize/detail/task.hpp>
+#include <fiberize/detail/tasktraits.hpp>
+
+namespace fiberize {
+
+template <typename A>
+class Coroutine;
+
+namespace detail {
+
+/**
+ * What a suspended coroutine waits for. It continues once ready(awaiter) returns true.
+ */
+struct CoroutineWait {
+    bool (*ready)(void* awaiter);
+    void* awaiter;
+};
+
+template <typename A>
+struct CoroutineResult {
+    template <typename B>
+    void return_value(B&& value) {
+        result.emplace(std::forward<B>(value));
+    }
+
+    boost::optional<Result<A>> result;
+};
+
+template <>
+struct CoroutineResult<void> {
+    void return_void() {
+        result.emplace();
+    }
+
+    boost::optional<Result<void>> result;
+};
+
+/**
+ * The promise type of coroutine tasks. Coroutines start suspended and stay suspended at the end,
+ * the task runs them and destroys them.
+ */
+template <typename A>
+class CoroutinePromise : public CoroutineResult<A> {
+public:
+    Coroutine<A> get_return_object() {
+        return Coroutine<A>(std::coroutine_handle<CoroutinePromise>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    std::suspend_always final_suspend() noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        this->result.emplace(Result<A>(std::current_exception()));
+    }
+
+    /**
+     * What the coroutine waits for, if it is suspended in a co_await.
+     */
+    CoroutineWait wait = {nullptr, nullptr};
+};
+
+/**
+ * Awaits an event. The handler is bound when the coroutine suspends, so an event emitted by an
+ * Async mode IO operation started right before is not missed.
+ */
+template <typename A>
+class EventAwaiter {
+public:
+    explicit EventAwaiter(const Event<A>& event) : event(event) {}
+
+    bool await_ready() const {
+        return false;
+    }
+
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> handle) {
+        handler = event.bind([this] (const A& received) {
+            value = received;
+            handler.release();
+        });
+        handle.promise().wait = CoroutineWait{&EventAwaiter::ready, this};
+    }
+
+    A await_resume() {
+        return std::move(value.get());
+    }
+
+private:
+    static bool ready(void* awaiter) {
+        return static_cast<EventAwaiter*>(awaiter)->value.is_initialized();
+    }
+
+    Event<A> event;
+    HandlerRef handler;
+    boost::optional<A> value;
+};
+
+template <>
+class EventAwaiter<void> {
+public:
+    explicit EventAwaiter(const Event<void>& event) : event(event), fired(false) {}
+
+    bool await_ready() const {
+        return false;
+    }
+
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> handle) {
+        handler = event.bind([this] () {
+            fired = true;
+            handler.release();
+        });
+        handle.promise().wait = CoroutineWait{&EventAwaiter::ready, this};
+    }
+
+    void await_resume() {}
+
+private:
+    static bool ready(void* awaiter) {
+        return static_cast<EventAwaiter*>(awaiter)->fired;
+    }
+
+    Event<void> event;
+    HandlerRef handler;
+    bool fired;
+};
+
+/**
+ * Awaits a promise. The task is resumed by the promise like a fiber awaiting it would be, but
+ * it doesn't suspend on the promise's condition.
+ */
+template <typename A>
+class PromiseAwaiter {
+public:
+    explicit PromiseAwaiter(Promise<A>* promise) : promise(promise), ticket(0) {}
+    PromiseAwaiter(PromiseAwaiter&&) = default;
+
+    ~PromiseAwaiter() {
+        if (ticket != 0 && !promise->signaled(ticket))
+            promise->unsubscribe(ticket);
+    }
+
+    bool await_ready() const {
+        return promise == nullptr;
+    }
+
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> handle) {
+        ticket = promise->subscribe();
+        if (ticket == 0) {
+            // Already complete, continue right away.
+            return false;
+        }
+
+        handle.promise().wait = CoroutineWait{&PromiseAwaiter::ready, this};
+        return true;
+    }
+
+    A await_resume() {
+        return promise->await();
+    }
+
+protected:
+    static bool ready(void* awaiter) {
+        PromiseAwaiter* self = static_cast<PromiseAwaiter*>(awaiter);
+        return self->promise->signaled(self->ticket);
+    }
+
+    Promise<A>* promise;
+    uint64_t ticket;
+};
+
+/**
+ * Awaits the result of a future, keeping the future alive.
+ */
+template <typename A>
+class FutureAwaiter : public PromiseAwaiter<Result<A>> {
+public:
+    explicit FutureAwaiter(FutureRef<A> future)
+        : PromiseAwaiter<Result<A>>(future.promise()), future(std::move(future)) {}
+
+    Result<A> await_resume() {
+        // A future without a promise never blocks.
+        if (this->promise == nullptr)
+            return future.await();
+        return this->promise->await();
+    }
+
+private:
+    FutureRef<A> future;
+};
+
+/**
+ * Runs a coroutine task up to its next suspension point. The first run creates the coroutine,
+ * the following ones process the pending events and continue the coroutine if whatever it awaits
+ * is ready. Once the coroutine returns the result completes the future and the task stops.
+ */
+template <typename A, typename Function>
+class CoroutineStep {
+public:
+    using Handle = std::coroutine_handle<CoroutinePromise<A>>;
+
+    explicit CoroutineStep(Function function) : function(std::move(function)) {}
+
+    CoroutineStep(CoroutineStep&& other)
+        : function(std::move(other.function)), handle(std::exchange(other.handle, nullptr)) {}
+
+    ~CoroutineStep() {
+        if (handle)
+            handle.destroy();
+    }
+
+    void operator () () {
+        auto future = static_cast<Future<A>*>(context::detail::task());
+
+        if (!handle) {
+            try {
+                Coroutine<A> coroutine = function();
+                handle = std::exchange(coroutine.handle, nullptr);
+            } catch (...) {
+                future->result.complete(Result<A>(std::current_exception()));
+                context::stop();
+                return;
+            }
+        } else {
+            std::unique_lock<Spinlock> lock(future->spinlock);
+            try {
+                context::detail::process(lock);
+            } catch (...) {
+                // The task is stopped, for example killed. Nobody waits for the result forever.
+                future->result.complete(Result<A>(std::current_exception()));
+                throw;
+            }
+            bool stopped = future->stopped;
+            lock.unlock();
+
+            CoroutineWait& wait = handle.promise().wait;
+            if (stopped || (wait.ready != nullptr && !wait.ready(wait.awaiter)))
+                return;
+        }
+
+        handle.promise().wait = CoroutineWait{nullptr, nullptr};
+        handle.resume();
+
+        if (handle.done()) {
+            future->result.complete(std::move(handle.promise().result.get()));
+            handle.destroy();
+            handle = nullptr;
+            context::stop();
+        }
+    }
+
+private:
+    Function function;
+    Handle handle;
+};
+
+struct CoroutineTraits {
+    template <typename R>
+    struct ForResult;
+
+    /**
+     * References and dead tasks are the same as for futures.
+     */
+    template <typename A>
+    struct ForResult<Coroutine<A>> : FutureTraits::ForResult<A> {
+        using TaskType = Future<A>;
+
+        template <typename Runnable>
+        static TaskType*
+        newTask(const Path& path, std::unique_ptr<Mailbox> mailbox, Scheduler* pin, Runnable runnable) {
+            auto task = new Future<A>;
+            task->pin = pin;
+            task->path = path;
+            task->mailbox = std::move(mailbox);
+            task->status = Listening;
+            task->coroutine = true;
+            task->runnable = makeRunnable(CoroutineStep<A, Runnable>(std::move(runnable)));
+            return task;
+        }
+    };
+};
+
+} // namespace detail
+
+/**
+ * Return type of coroutines run as tasks with FiberSystem::coroutine. The coroutine can co_await
+ * an Event<A>, a FutureRef<A>, a Promise<A> or the event returned by an Async mode IO operation.
+ * The value of the co_return statement becomes the result of the future.
+ *
+ * A coroutine task has no stack of its own, it runs on the stack of the scheduler between its
+ * suspension points. It must not suspend like a fiber, for example with Event::await().
+ *
+ * @code
+ *   Coroutine<int> answer(Event<int> question) {
+ *       int value = co_await question;
+ *       co_await io::sleep<io::Async>(1s);
+ *       co_return value + 1;
+ *   }
+ *
+ *   FutureRef<int> ref = system.coroutine(answer).run(question);
+ * @endcode
+ */
+template <typename A>
+class Coroutine {
+public:
+    using promise_type = detail::CoroutinePromise<A>;
+
+    Coroutine(Coroutine&& other) : handle(std::exchange(other.handle, nullptr)) {}
+    Coroutine(const Coroutine&) = delete;
+    Coroutine& operator = (const Coroutine&) = delete;
+    Coroutine& operator = (Coroutine&&) = delete;
+
+    ~Coroutine() {
+        if (handle)
+            handle.destroy();
+    }
+
+private:
+    explicit Coroutine(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    friend promise_type;
+
+    template <typename B, typename Function>
+    friend class detail::CoroutineStep;
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename A>
+detail::EventAwaiter<A> operator co_await(const Event<A>& event) {
+    return detail::EventAwaiter<A>(event);
+}
+
+template <typename A>
+detail::PromiseAwaiter<A> operator co_await(Promise<A>& promise) {
+    return detail::PromiseAwaiter<A>(&promise);
+}
+
+template <typename A>
+detail::FutureAwaiter<A> operator co_await(const FutureRef<A>& future) {
+    return detail::FutureAwaiter<A>(future);
+}
+
+} // namespace fiberize
+
+#endif // FIBERIZE_COROUTINES
+
+#endif // FIBERIZE_COROUTINE_HPP
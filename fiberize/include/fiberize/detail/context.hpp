@@ -0,0 +1,72 @@
+/**
+ * Saved execution contexts and switching between them.
+ *
+ * @file context.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_CONTEXT_HPP
+#define FIBERIZE_DETAIL_CONTEXT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <boost/context/all.hpp>
+
+/**
+ * The in-tree switch is used on x86-64 and AArch64 ELF platforms when enabled with the FAST_CONTEXT
+ * CMake option, everything else falls back to Boost.Context.
+ */
+#if defined(FIBERIZE_FAST_CONTEXT) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+#define FIBERIZE_INTREE_CONTEXT
+#endif
+
+#ifdef FIBERIZE_INTREE_CONTEXT
+extern "C" intptr_t fiberize_jump_context(void** from, void* to, intptr_t vp, int restoreFpu);
+#endif
+
+namespace fiberize {
+namespace detail {
+
+#ifdef FIBERIZE_INTREE_CONTEXT
+
+/**
+ * A suspended context, the stack pointer it was suspended at.
+ */
+typedef void* Context;
+
+/**
+ * Saves the current context in from and resumes the context to. Saves only the callee-saved
+ * registers and the floating point control registers, which are loaded again only if restoreFpu
+ * is set. The value vp is returned by the jump that suspended the resumed context.
+ */
+inline intptr_t jumpContext(Context* from, Context to, intptr_t vp, bool restoreFpu) {
+    return fiberize_jump_context(from, to, vp, restoreFpu);
+}
+
+/**
+ * Creates a context which calls fn on the given stack when resumed. The stack grows down from sp.
+ * @warning The function must never return.
+ */
+Context makeContext(void* sp, size_t size, void (*fn)(intptr_t));
+
+#else
+
+typedef boost::context::fcontext_t Context;
+
+/**
+ * Boost.Context saves the floating point control registers only when it restores them.
+ */
+inline intptr_t jumpContext(Context* from, Context to, intptr_t vp, bool restoreFpu) {
+    return boost::context::jump_fcontext(from, to, vp, restoreFpu);
+}
+
+inline Context makeContext(void* sp, size_t size, void (*fn)(intptr_t)) {
+    return boost::context::make_fcontext(sp, size, fn);
+}
+
+#endif
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_CONTEXT_HPP
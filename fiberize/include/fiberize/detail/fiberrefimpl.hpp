@@ -35,6 +35,20 @@ public:
      * Emits an event for an appropriatly stored value.
      */
     virtual void send(const PendingEvent& pendingEvent) = 0;
+
+    /**
+     * Emits an event and switches to the receiver if it can run right away. Defaults to send.
+     */
+    virtual void sendAndSwitch(const PendingEvent& pendingEvent) {
+        send(pendingEvent);
+    }
+
+    /**
+     * Emits an event that has to be handled by the given deadline. Defaults to send.
+     */
+    virtual void sendWithDeadline(const PendingEvent& pendingEvent, uint64_t) {
+        send(pendingEvent);
+    }
 };
 
 template <typename A>
@@ -44,6 +58,13 @@ public:
      * Awaits for the result of this future.
      */
     virtual Result<A> await() = 0;
+
+    /**
+     * The promise holding the result, or nullptr if await() never blocks.
+     */
+    virtual Promise<Result<A>>* promise() {
+        return nullptr;
+    }
 };
 
 } // namespace detail
@@ -0,0 +1,95 @@
+/**
+ * Bookkeeping of spinning and parked macrothreads.
+ *
+ * @file idleworkers.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_IDLEWORKERS_HPP
+#define FIBERIZE_DETAIL_IDLEWORKERS_HPP
+
+#include <atomic>
+#include <vector>
+
+#include <fiberize/spinlock.hpp>
+
+namespace fiberize {
+namespace detail {
+
+class MultiTaskScheduler;
+
+/**
+ * Tracks which multitasking schedulers are looking for work and which are parked.
+ *
+ * A scheduler that runs out of tasks becomes spinning while it tries to steal. If stealing fails
+ * it stops spinning and parks in its IO loop. New work wakes a parked scheduler only if no scheduler
+ * is spinning, because a spinning one will find the work anyway. When a spinning scheduler finds
+ * a task and it was the last one spinning, it wakes another scheduler to look for the remaining work.
+ * At most half of the active schedulers can spin at the same time.
+ */
+class IdleWorkers {
+public:
+    explicit IdleWorkers(uint32_t workers);
+
+    /**
+     * Changes the number of active schedulers.
+     */
+    void setWorkers(uint32_t workers);
+
+    /**
+     * Tries to register the caller as spinning.
+     * @param force whether to ignore the limit of spinning schedulers.
+     * @returns false if too many schedulers are already spinning.
+     */
+    bool startSpinning(bool force = false);
+
+    /**
+     * Unregisters a spinning scheduler.
+     * @param foundWork whether the scheduler stops spinning because it found a task.
+     */
+    void stopSpinning(bool foundWork);
+
+    /**
+     * Wakes a parked scheduler, unless some scheduler is already spinning. The woken scheduler
+     * starts spinning.
+     */
+    void wakeOne();
+
+    /**
+     * Wakes the given scheduler if it is parked.
+     */
+    void wake(MultiTaskScheduler* scheduler);
+
+    /**
+     * Registers the scheduler as parked.
+     */
+    void park(MultiTaskScheduler* scheduler);
+
+    /**
+     * Unregisters a parked scheduler.
+     * @returns false if it was already woken by someone else.
+     */
+    bool unpark(MultiTaskScheduler* scheduler);
+
+    /**
+     * Number of spinning schedulers.
+     */
+    inline uint32_t spinning() const { return spinning_.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of parked active schedulers.
+     */
+    inline uint32_t parked() const { return parkedCount.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> workers;
+    std::atomic<uint32_t> spinning_;
+    std::atomic<uint32_t> parkedCount;
+
+    Spinlock spinlock;
+    std::vector<MultiTaskScheduler*> parked_;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_IDLEWORKERS_HPP
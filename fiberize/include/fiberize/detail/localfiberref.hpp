@@ -24,9 +24,17 @@ public:
     Locality locality() const override;
     Path path() const override;
     void send(const PendingEvent& pendingEvent) override;
+    void sendAndSwitch(const PendingEvent& pendingEvent) override;
+    void sendWithDeadline(const PendingEvent& pendingEvent, uint64_t deadline) override;
 
     FiberSystem* const system;
     Task* task;
+
+private:
+    /**
+     * Enqueues the event in the mailbox of the task and returns the task's lock.
+     */
+    std::unique_lock<Spinlock> enqueue(const PendingEvent& pendingEvent);
 };
 
 template <typename A>
@@ -52,17 +60,37 @@ public:
     }
 
     void send(const PendingEvent& pendingEvent) override {
-        std::unique_lock<Spinlock> lock(future->spinlock);
-        future->mailbox->enqueue(pendingEvent);
-        context::detail::resume(future, std::move(lock));
+        context::detail::resume(future, enqueue(pendingEvent));
+    }
+
+    void sendAndSwitch(const PendingEvent& pendingEvent) override {
+        context::detail::resumeAndSwitch(future, enqueue(pendingEvent));
+    }
+
+    void sendWithDeadline(const PendingEvent& pendingEvent, uint64_t deadline) override {
+        context::detail::resumeWithDeadline(future, deadline, enqueue(pendingEvent));
     }
 
     Result<A> await() override {
         return future->result.await();
     }
 
+    Promise<Result<A>>* promise() override {
+        return &future->result;
+    }
+
     FiberSystem* const system;
     Future<A>* future;
+
+private:
+    /**
+     * Enqueues the event in the mailbox of the future and returns the future's lock.
+     */
+    std::unique_lock<Spinlock> enqueue(const PendingEvent& pendingEvent) {
+        std::unique_lock<Spinlock> lock(future->spinlock);
+        future->mailbox->enqueue(pendingEvent);
+        return lock;
+    }
 };
 
 } // namespace detail
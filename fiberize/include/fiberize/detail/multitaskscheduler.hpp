@@ -7,45 +7,365 @@
 #ifndef FIBERIZE_DETAIL_MULTITASKSCHEDULER_HPP
 #define FIBERIZE_DETAIL_MULTITASKSCHEDULER_HPP
 
-#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+#include <boost/lockfree/queue.hpp>
+#include <boost/optional.hpp>
 
 #include <fiberize/scheduler.hpp>
+#include <fiberize/spinlock.hpp>
+#include <fiberize/topology.hpp>
+#include <fiberize/detail/spscring.hpp>
+#include <fiberize/detail/stackprofile.hpp>
+#include <fiberize/detail/stackpool.hpp>
+#include <fiberize/detail/workstealingdeque.hpp>
 
 namespace fiberize {
 namespace detail {
 
-class StackPool;
+class IdleWorkers;
+struct SchedulerPool;
 
 /**
  * @ingroup lifecycle
  */
 class MultiTaskScheduler : public Scheduler {
 public:
-    MultiTaskScheduler(FiberSystem* system, uint64_t seed);
+    /**
+     * Schedulers to steal from, grouped in tiers from the closest to the farthest.
+     */
+    typedef std::vector<std::vector<MultiTaskScheduler*>> Victims;
+
+    MultiTaskScheduler(FiberSystem* system, uint32_t index, uint64_t seed);
     virtual ~MultiTaskScheduler();
 
+    /**
+     * Position of this scheduler in the order of creation.
+     */
+    inline uint32_t index() const { return index_; }
+
+    /**
+     * Pins the scheduler thread to the given CPU.
+     * @note Must be called before start().
+     */
+    void setCpu(const Cpu& cpu);
+
+    /**
+     * The CPU this scheduler is pinned to, if any.
+     */
+    inline const boost::optional<Cpu>& cpu() const { return cpu_; }
+
+    /**
+     * Adds the scheduler to a named pool.
+     * @note Must be called before start().
+     */
+    void setPool(SchedulerPool* pool);
+
+    /**
+     * The named pool of this scheduler, or nullptr for the default pool.
+     */
+    inline SchedulerPool* pool() const { return pool_; }
+
+    /**
+     * Sets the victims this scheduler steals from. If there are none, random schedulers are chosen.
+     * The victims must stay alive until the fiber system is destroyed.
+     * @note Thread-safe.
+     */
+    void setVictims(const Victims* victims);
+
     void start();
     void stop();
 
+    /**
+     * Runs the scheduler on the calling thread, until it is stopped or handed over to another thread.
+     * @note Called by SchedulerThreads.
+     */
+    void run();
+
+    /**
+     * Retires the scheduler. It stops stealing and moves unpinned tasks to the active schedulers,
+     * but keeps running tasks pinned to it, until it is reactivated.
+     * @note Thread-safe.
+     */
+    void retire();
+
+    /**
+     * Makes a retired scheduler active again.
+     * @note Thread-safe.
+     */
+    void reactivate();
+
+    /**
+     * Whether the scheduler is retired.
+     * @note Thread-safe, but the result might be stale.
+     */
+    inline bool isRetired() const { return retired.load(std::memory_order_relaxed); }
+
+    /**
+     * Approximate number of tasks waiting in the local queues.
+     * @note Thread-safe.
+     */
+    size_t load() const;
+
+    /**
+     * Asks the running task to yield if it exceeded its time slice. Sends the given signal to the
+     * scheduler thread or, if the signal is 0, sets the preemption flag directly.
+     * @note Thread-safe.
+     */
+    void requestPreemption(uint64_t now, int signal);
+
+    /**
+     * Yields the current task if it exceeded its time slice. Called at safepoints.
+     */
+    void preempt();
+
+    /**
+     * Hands the scheduler over to a standby thread if the current task has been blocking the
+     * scheduler thread for too long.
+     * @note Thread-safe.
+     */
+    void requestHandoff(uint64_t now);
+
+    /**
+     * Whether a task is running or blocking. Used by the monitor to back off when the system is idle.
+     * @note Thread-safe, but the result might be stale.
+     */
+    bool busy() const;
+
+    /**
+     * Marks the start of a blocking call made by the current task. The scheduler can be handed over
+     * to another thread until leaveBlocking() is called, so the task must not use it in between.
+     * @returns false if handoffs are disabled.
+     */
+    bool enterBlocking();
+
+    /**
+     * Marks the end of a blocking call. If the scheduler was handed over, the task is rescheduled
+     * and continues on some scheduler thread.
+     */
+    static void leaveBlocking();
+
     void resume(Task* task, std::unique_lock<Spinlock> lock);
+
+    /**
+     * Switches from the current task directly to the given suspended task. The current task is
+     * rescheduled. If this is not possible the task is resumed normally.
+     */
+    void switchTo(Task* task, std::unique_lock<Spinlock> lock);
+
+    /**
+     * Queues another copy of a scheduled task whose deadline got earlier. The copy holds a reference
+     * to the task. Whichever copy is taken first runs the task, the others are dropped when taken.
+     */
+    void escalate(Task* task, std::unique_lock<Spinlock> lock);
     void suspend() override;
     void yield() override;
     Task* currentTask() override;
     bool isMultiTasking() override;
 
 private:
-    std::thread thread;
+    friend class IdleWorkers;
+
     std::atomic<bool> stopping;
+    std::atomic<bool> retired;
+
+    /**
+     * Whether some thread is running the scheduler. Cleared when the scheduler stops.
+     */
+    bool running;
+    std::mutex runningMutex;
+    std::condition_variable runningCondition;
+
+    /**
+     * Blocking calls are numbered, the number is odd while a call is in progress. The blocked task
+     * and the monitor race to make it even again and the monitor hands the scheduler over if it wins.
+     */
+    std::atomic<uint64_t> blockingCall;
+    std::atomic<uint64_t> blockingSince;
+    const bool handoff;
+    const uint64_t handoffDelay;
+
+    /**
+     * When the running task got the CPU, zero if no task is running.
+     */
+    std::atomic<uint64_t> sliceStart;
+    const uint64_t timeSlice;
+    const uint64_t overrunThreshold;
+
+    /**
+     * The preemption flag of the scheduler thread and its handle, published when the thread starts.
+     */
+    std::atomic<std::atomic<bool>*> preemptFlag;
+    std::atomic<pthread_t> threadHandle;
+
+    void beginSlice();
+    void endSlice();
+
+    /**
+     * Whether this scheduler is registered as spinning. Accessed only by the owner.
+     */
+    bool spinning;
+
+    /**
+     * Whether this scheduler is registered as parked. Changed under the IdleWorkers lock.
+     */
+    std::atomic<bool> parked;
+
+    /**
+     * Set when a waker handed its spinning slot over to this scheduler.
+     */
+    std::atomic<bool> wokenSpinning;
+
+    boost::optional<Cpu> cpu_;
+    std::atomic<const Victims*> victims;
+
+    /**
+     * The named pool of this scheduler, or nullptr.
+     */
+    SchedulerPool* pool_;
 
-    std::deque<Task*> softTasks;
-    Spinlock softMutex;
-    void dequeueSoft(Task*& task);
-    void stealSoft(Task*& task);
+    /**
+     * The active schedulers and the idle workers of the pool.
+     */
+    const std::vector<MultiTaskScheduler*>& peers();
+    IdleWorkers& idleWorkers();
 
-    std::deque<Task*> hardTasks;
-    Spinlock hardMutex;
-    void dequeueHard(Task*& task);
-    void stealHard(Task*& task);
+    /**
+     * Whether to steal half of the victim's tasks.
+     */
+    bool stealHalf;
+
+    /**
+     * Whether the system is sharded. Sharded schedulers don't steal and only run tasks pinned to them.
+     */
+    const bool sharded;
+
+    /**
+     * When thieves can take tasks preferring this scheduler.
+     */
+    const uint64_t preferredStealDelay;
+    const size_t preferredStealDepth;
+
+    /**
+     * Local queues of a priority class.
+     */
+    struct Queues {
+        /**
+         * Unpinned tasks. Only the owner pushes and pops, other schedulers steal.
+         */
+        WorkStealingDeque<Task*> softTasks;
+        WorkStealingDeque<Task*> hardTasks;
+
+        /**
+         * Tasks pinned to this scheduler. Accessed only by the owner.
+         */
+        std::deque<Task*> pinnedSoftTasks;
+        std::deque<Task*> pinnedHardTasks;
+
+        /**
+         * Unpinned tasks preferring this scheduler, with the time they were queued. The owner takes
+         * them first, thieves only when they waited too long or too many of them piled up.
+         */
+        std::deque<std::pair<uint64_t, Task*>> preferredTasks;
+        std::atomic<size_t> preferredCount{0};
+        Spinlock preferredSpinlock;
+    };
+
+    Queues queues[priorityClasses];
+
+    /**
+     * For each priority class, the number of tasks of higher classes that ran since a task
+     * of this class was taken while some were waiting. Accessed only by the owner.
+     */
+    uint64_t skipped[priorityClasses];
+
+    /**
+     * Tasks with a deadline, in min-heaps ordered by the deadline. Thieves take from the unpinned
+     * heap under the spinlock, the pinned heap is accessed only by the owner.
+     */
+    typedef std::pair<uint64_t, Task*> DeadlineEntry;
+    std::vector<DeadlineEntry> deadlineTasks;
+    std::atomic<size_t> deadlineCount;
+    Spinlock deadlineSpinlock;
+    std::vector<DeadlineEntry> pinnedDeadlineTasks;
+
+    /**
+     * Tasks resumed by other threads. The owner moves them to the local queues,
+     * other schedulers can steal the unpinned ones directly from here.
+     */
+    boost::lockfree::queue<Task*> remoteTasks;
+    boost::lockfree::queue<Task*> remotePinnedTasks;
+
+    /**
+     * Approximate number of tasks in the remote queues, which can't tell their size.
+     */
+    std::atomic<size_t> remoteCount;
+
+    /**
+     * Unpinned tasks resumed by another scheduler. The producer pushes without any synchronization.
+     * The consumer holds the spinlock, which is normally the owner, but thieves can drain the inbox
+     * when the owner is busy.
+     */
+    struct Inbox {
+        SpscRing<Task*> tasks;
+        Spinlock consumer;
+        Inbox* next;
+    };
+
+    /**
+     * Inboxes of this scheduler, one for each scheduler that resumed a task here. The list only grows.
+     */
+    std::atomic<Inbox*> inboxes;
+
+    /**
+     * Inboxes this scheduler pushes to, indexed by the consuming scheduler. Accessed only by the owner.
+     */
+    std::vector<Inbox*> outboxes;
+
+    const uint32_t index_;
+
+    /**
+     * The most recently resumed unpinned task, executed before anything else so that it runs
+     * while the message that woke it is still in the cache. Only the owner puts tasks here,
+     * thieves take the task only if it has been waiting for too long.
+     */
+    std::atomic<Task*> runNext;
+    std::atomic<uint64_t> runNextTime;
+
+    /**
+     * Number of tasks in a row taken from runNext.
+     */
+    uint64_t runNextStreak;
+
+    void post(Task* task, bool pinned);
+    void migrate();
+    void enqueue(Task* task);
+    void enqueueNext(Task* task);
+    void stealNext(Task*& task);
+    void drainRemote();
+    bool pushInbox(MultiTaskScheduler* target, Task* task);
+    Inbox* addInbox();
+
+    void dequeueSoft(Task*& task, size_t level);
+    void stealSoft(Task*& task, MultiTaskScheduler* thief, size_t level);
+
+    void dequeueHard(Task*& task, size_t level);
+    void stealHard(Task*& task, MultiTaskScheduler* thief, size_t level);
+
+    void stealFrom(WorkStealingDeque<Task*>& victim, Task*& task, WorkStealingDeque<Task*>& local);
+
+    void stealRemote(Task*& task);
+
+    void dequeuePreferred(Task*& task, size_t level);
+    void stealPreferred(Task*& task, size_t level);
+    void dequeueDeadline(Task*& task);
+    void stealDeadline(Task*& task);
 
     enum Priority : uint8_t {
         Soft = 0,
@@ -53,35 +373,71 @@ private:
     };
 
     void dequeue(Task*& task, Priority priority);
+    void dequeueLevel(Task*& task, size_t level, Priority priority, bool preferNext);
+    bool waiting(size_t level);
+    void served(size_t level);
     void steal(Task*& task, Priority priority);
+    void stopSpinning();
+    void park();
+    bool hasWork();
+    bool hasStealableWork() const;
+    void stealFrom(MultiTaskScheduler* target, Task*& task, Priority priority);
     Priority choosePriority(Priority preferred);
 
+    /**
+     * Finds the next task to run. Suspended tasks are claimed right away, the others once they start
+     * processing, so that only one copy of an escalated task runs it.
+     * @see escalate()
+     */
+    void take(Task*& task, Priority priority);
+
+    /**
+     * Gives up a taken copy of a task that can't run it. The copy is queued again if the task is still
+     * scheduled, otherwise its reference is dropped.
+     */
+    void discard(Task* task, std::unique_lock<Spinlock> lock);
+
     void finishSuspending();
+    void processInline(const boost::context::stack_context& stack);
+    static void finishSwitching();
     static void ownedLoop();
     static void unownedLoop();
 
-    struct UnownedContext {
-        boost::context::fcontext_t context;
-        boost::context::stack_context stack;
-    };
-
     uint64_t sameStreak;
     Task* suspendingTask;
     Task* currentTask_;
     UnownedContext* unowned;
-    boost::context::fcontext_t initialContext;
 
-    std::vector<UnownedContext*> stash;
-    UnownedContext* stashGet();
+    /**
+     * Status of the current task when take() found it.
+     */
+    TaskStatus takenStatus;
+
+    /**
+     * The task processing events on a stack it doesn't own, or nullptr.
+     * @see Builder::nonBlockingHandlers
+     */
+    Task* inlineTask;
+
+    /**
+     * Unowned context left for one with a stack of another size, stashed after the jump.
+     */
+    UnownedContext* replacedUnowned;
+    Context initialContext;
+
+    /**
+     * Stacks kept by this scheduler for each size class, exchanged with the shared pool in batches.
+     */
+    std::vector<UnownedContext*> stashes[StackPool::sizeClasses];
+    StackPool& stackPool;
+    UnownedContext* stashGet(uint8_t sizeClass);
     void stashPut(UnownedContext* context);
     void stashClear();
 
-#ifdef FIBERIZE_SEGMENTED_STACKS
-    boost::context::segmented_stack stackAllocator;
-#else
-    boost::context::fixedsize_stack stackAllocator;
-#endif
-
+    /**
+     * Where the stack usage of tasks is recorded, nullptr if it is not measured.
+     */
+    StackProfile* stackProfile;
 };
 
 } // namespace detail
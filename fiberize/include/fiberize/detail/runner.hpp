@@ -7,13 +7,15 @@
 #ifndef FIBERIZE_DETAIL_RUNNER_HPP
 #define FIBERIZE_DETAIL_RUNNER_HPP
 
+#include <fiberize/placement.hpp>
+
 namespace fiberize {
 namespace detail {
 
 class Task;
 
-void runTaskAsMicrothread(Task* task);
-void runTaskAsOSThread(Task* task);
+void runTaskAsMicrothread(Task* task, Placement placement);
+void runTaskAsOSThread(Task* task, Placement placement);
 
 } // namespace detail
 } // namespace fiberize
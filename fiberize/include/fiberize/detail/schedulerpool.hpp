@@ -0,0 +1,46 @@
+/**
+ * Named group of multitasking schedulers.
+ *
+ * @file schedulerpool.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_SCHEDULERPOOL_HPP
+#define FIBERIZE_DETAIL_SCHEDULERPOOL_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fiberize/detail/idleworkers.hpp>
+
+namespace fiberize {
+namespace detail {
+
+class MultiTaskScheduler;
+
+/**
+ * A named pool of macrothreads. Tasks started in a pool only run on its schedulers, which steal
+ * only from each other. The default pool is not represented by this structure, it is the resizable
+ * set of schedulers kept by the FiberSystem itself.
+ */
+struct SchedulerPool {
+    /**
+     * Name of the pool.
+     */
+    std::string name;
+
+    /**
+     * Schedulers of the pool. Fixed when the system starts.
+     */
+    std::vector<MultiTaskScheduler*> schedulers;
+
+    /**
+     * Spinning and parked schedulers of the pool.
+     */
+    std::unique_ptr<IdleWorkers> idleWorkers;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_SCHEDULERPOOL_HPP
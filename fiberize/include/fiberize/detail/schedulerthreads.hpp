@@ -0,0 +1,59 @@
+/**
+ * OS threads running the multitasking schedulers.
+ *
+ * @file schedulerthreads.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_SCHEDULERTHREADS_HPP
+#define FIBERIZE_DETAIL_SCHEDULERTHREADS_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fiberize {
+namespace detail {
+
+class MultiTaskScheduler;
+
+/**
+ * A pool of OS threads that run the multitasking schedulers.
+ *
+ * A scheduler is not tied to a thread. When a task blocks its thread for too long, the scheduler
+ * is handed over to a standby thread, which keeps running the other tasks. The blocked thread
+ * becomes a standby thread once the call returns. Threads are created on demand and kept until
+ * the pool is stopped.
+ */
+class SchedulerThreads {
+public:
+    SchedulerThreads();
+    ~SchedulerThreads();
+
+    /**
+     * Runs the scheduler on a standby thread, creating one if necessary.
+     * @note Thread-safe.
+     */
+    void run(MultiTaskScheduler* scheduler);
+
+    /**
+     * Waits until all threads finish. The schedulers must be stopped first.
+     */
+    void stop();
+
+private:
+    void work();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<MultiTaskScheduler*> pending;
+    std::vector<std::thread> threads;
+    uint32_t standby;
+    bool stopping;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_SCHEDULERTHREADS_HPP
@@ -33,6 +33,11 @@ public:
 private:
     Task* task_;
     std::atomic<bool> resumed;
+
+    /**
+     * Whether the thread is waiting in the IO loop and has to be woken up.
+     */
+    std::atomic<bool> sleeping;
 };
 
 } // namespace detail
@@ -0,0 +1,114 @@
+/**
+ * Lock-free single producer, single consumer ring.
+ *
+ * @file spscring.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_SPSCRING_HPP
+#define FIBERIZE_DETAIL_SPSCRING_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * Bounded ring buffer with one producer and one consumer.
+ *
+ * Each side keeps a cached copy of the other side's index and refreshes it only when the ring
+ * looks full or empty, so a batch of pushes followed by a batch of pops moves the indices
+ * between the cores only a few times.
+ *
+ * @tparam A A trivially copyable value type, usually a pointer.
+ */
+template <typename A>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 256)
+        : head(0), cachedTail(0), tail(0), cachedHead(0) {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        mask = size - 1;
+        values.reset(new A[size]);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator = (const SpscRing&) = delete;
+
+    /**
+     * Pushes a value.
+     * @returns false if the ring is full.
+     * @note Can only be called by the producer.
+     */
+    bool push(A value) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask)
+                return false;
+        }
+
+        values[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops a value.
+     * @returns whether a value was popped.
+     * @note Can only be called by the consumer.
+     */
+    bool pop(A& value) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+
+        value = values[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Approximate number of values in the ring.
+     * @note Thread-safe, but the result might be stale.
+     */
+    size_t size() const {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        return t > h ? size_t(t - h) : 0;
+    }
+
+    /**
+     * Whether the ring looks empty.
+     * @note Thread-safe, but the result might be stale.
+     */
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_relaxed);
+    }
+
+private:
+    size_t mask;
+    std::unique_ptr<A[]> values;
+
+    /**
+     * The consumer's and the producer's indices live on separate cache lines.
+     */
+    char padding0[64];
+    std::atomic<uint64_t> head;
+    uint64_t cachedTail;
+    char padding1[64];
+    std::atomic<uint64_t> tail;
+    uint64_t cachedHead;
+    char padding2[64];
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_SPSCRING_HPP
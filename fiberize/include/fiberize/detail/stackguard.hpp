@@ -0,0 +1,42 @@
+/**
+ * Detection of microthread stack overflows.
+ *
+ * @file stackguard.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_STACKGUARD_HPP
+#define FIBERIZE_DETAIL_STACKGUARD_HPP
+
+#include <cstddef>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * Installs a SIGSEGV handler, which recognizes faults caused by the running task overflowing its
+ * stack into the guard page, reports the path of the task and the size of its stack, and aborts.
+ * Other faults are passed to the previously installed handler. Installed at most once per process.
+ */
+void installStackOverflowHandler();
+
+/**
+ * An alternate signal stack for the calling thread, so that the stack overflow handler can run
+ * when the stack the thread runs on is exhausted. Disabled again when destroyed.
+ */
+class AlternateSignalStack {
+public:
+    AlternateSignalStack();
+    ~AlternateSignalStack();
+
+    AlternateSignalStack(const AlternateSignalStack&) = delete;
+    AlternateSignalStack& operator = (const AlternateSignalStack&) = delete;
+
+private:
+    void* memory;
+    size_t size;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_STACKGUARD_HPP
@@ -0,0 +1,223 @@
+/**
+ * Pool of microthread stacks shared by the schedulers.
+ *
+ * @file stackpool.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_STACKPOOL_HPP
+#define FIBERIZE_DETAIL_STACKPOOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <boost/context/all.hpp>
+
+#include <fiberize/spinlock.hpp>
+#include <fiberize/detail/context.hpp>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * A stack together with a context suspended on it, ready to run the scheduler loop.
+ */
+struct UnownedContext {
+    Context context;
+    boost::context::stack_context stack;
+
+    /**
+     * Size class of the stack.
+     */
+    uint8_t sizeClass;
+
+    /**
+     * Whether the unused part of the stack was given back to the OS.
+     */
+    bool released;
+};
+
+/**
+ * Stacks not used by any task, shared by all schedulers of a system.
+ *
+ * Each scheduler keeps a few stacks for itself and exchanges them with the pool in batches, so
+ * stacks of tasks migrating between schedulers are reused instead of freed and allocated again.
+ * The pool is split into shards, each scheduler goes to its own shard first and takes stacks
+ * from the other shards only when its shard is empty.
+ *
+ * Stacks come in size classes, powers of two from 16KB to 16MB, and every class is pooled separately.
+ *
+ * Stacks are mapped lazily, a page is committed only when a task touches it. The pool keeps up to
+ * the low watermark of stacks as they are. Above that the unused pages of returned stacks are given
+ * back to the OS with madvise, but stay mapped. Stacks above the high watermark are unmapped.
+ * The watermarks count stacks of the default size, so a class of stacks twice as big gets half
+ * of them.
+ *
+ * Optionally each stack is mapped with a guard page below it, so that an overflow faults instead
+ * of corrupting the memory next to the stack. The fault is reported by the stack overflow handler.
+ * A guard page splits the mapping of its stack in two, so only the stacks allocated while the pool
+ * is small enough to stay well within the kernel's limit of memory mappings are guarded.
+ */
+class StackPool {
+public:
+    /**
+     * Number of size classes.
+     */
+    static constexpr uint8_t sizeClasses = 11;
+
+    /**
+     * Size of the smallest class.
+     */
+    static constexpr size_t minSize = 16 * 1024;
+
+    /**
+     * Returns the smallest class fitting the given size, or the class of the default size if it is 0.
+     * Sizes above the largest class get the largest class.
+     */
+    static uint8_t sizeClass(size_t size);
+
+    /**
+     * Returns the size of the stacks in the given class.
+     */
+    static inline size_t classSize(uint8_t sizeClass) { return minSize << sizeClass; }
+
+    /**
+     * Occupancy of the pool.
+     */
+    struct Stats {
+        /**
+         * Stacks currently mapped, both used and pooled.
+         */
+        uint64_t allocated;
+
+        /**
+         * Stacks in the shared pool, not counting the ones kept by the schedulers.
+         */
+        uint64_t pooled;
+
+        /**
+         * Pooled stacks whose unused pages were given back to the OS.
+         */
+        uint64_t released;
+    };
+
+    /**
+     * Creates a pool with the given number of shards.
+     * @param guardPages whether to put an inaccessible page below each stack.
+     * @param painting whether new stacks are painted with a canary pattern, to measure their usage.
+     *                 Painted stacks are not released, the released pages would lose the pattern.
+     */
+    StackPool(uint32_t shards, uint64_t lowWatermark, uint64_t highWatermark, bool guardPages, bool painting);
+    ~StackPool();
+
+    StackPool(const StackPool&) = delete;
+    StackPool& operator = (const StackPool&) = delete;
+
+    /**
+     * Maps a new stack of the given class.
+     */
+    boost::context::stack_context allocate(uint8_t sizeClass);
+
+    /**
+     * Unmaps a stack.
+     */
+    void deallocate(boost::context::stack_context& stack);
+
+    /**
+     * Takes up to max contexts of the given class, from the given shard first.
+     * @returns the number of contexts taken.
+     * @note Thread-safe.
+     */
+    size_t take(uint32_t shard, uint8_t sizeClass, UnownedContext** contexts, size_t max);
+
+    /**
+     * Returns contexts to the given shard. Contexts above the high watermark are destroyed.
+     * @note Thread-safe.
+     */
+    void give(uint32_t shard, UnownedContext* const* contexts, size_t count);
+
+    /**
+     * Paints a stack with the canary pattern, if painting is enabled.
+     */
+    void paint(const boost::context::stack_context& stack);
+
+    /**
+     * Returns how many bytes of a painted stack were used since it was painted and paints the used
+     * part again. Called on the measured stack, the part used by the caller is not painted.
+     */
+    static size_t measure(const boost::context::stack_context& stack);
+
+    /**
+     * Returns the current occupancy of all classes.
+     * @note Thread-safe, but the counters are not read atomically together.
+     */
+    Stats stats() const;
+
+    /**
+     * Returns the current occupancy of the given class.
+     * @note Thread-safe, but the counters are not read atomically together.
+     */
+    Stats stats(uint8_t sizeClass) const;
+
+private:
+    struct Shard {
+        Spinlock spinlock;
+        std::vector<UnownedContext*> contexts;
+
+        /**
+         * Number of contexts, read without the lock to skip empty shards.
+         */
+        std::atomic<size_t> size{0};
+        char padding[64];
+    };
+
+    /**
+     * Gives the unused pages of a stack back to the OS.
+     */
+    void release(UnownedContext* context);
+
+    /**
+     * Destroys a context and unmaps its stack.
+     */
+    void destroy(UnownedContext* context);
+
+    /**
+     * Counters and watermarks of a size class.
+     */
+    struct Class {
+        uint64_t lowWatermark;
+        uint64_t highWatermark;
+        std::atomic<uint64_t> allocated{0};
+        std::atomic<uint64_t> pooled{0};
+        std::atomic<uint64_t> released{0};
+    };
+
+    /**
+     * Shards of the given class.
+     */
+    inline Shard* shardsOf(uint8_t sizeClass) { return &shards[sizeClass * shardCount]; }
+
+    /**
+     * Size of the guard page below each stack, 0 if there are no guard pages.
+     */
+    const size_t guardSize;
+
+    /**
+     * Number of mapped stacks below which new stacks get a guard page.
+     */
+    const uint64_t guardedLimit;
+
+    /**
+     * Whether new stacks are painted.
+     */
+    const bool painting;
+
+    const uint32_t shardCount;
+    std::unique_ptr<Shard[]> shards;
+    Class classes[sizeClasses];
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_STACKPOOL_HPP
@@ -0,0 +1,75 @@
+/**
+ * Measured stack usage of tasks.
+ *
+ * @file stackprofile.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_STACKPROFILE_HPP
+#define FIBERIZE_DETAIL_STACKPROFILE_HPP
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <fiberize/path.hpp>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * Collects the high-water marks of the stacks of finished task runs, per task name.
+ * Unnamed tasks share the entry with the empty name.
+ */
+class StackProfile {
+public:
+    /**
+     * Stack usage of the tasks with one name.
+     */
+    struct Usage {
+        /**
+         * Number of measured runs.
+         */
+        uint64_t samples;
+
+        /**
+         * The most stack used by a single run, in bytes.
+         */
+        size_t peak;
+
+        /**
+         * Size of the stack of the last measured run, in bytes.
+         */
+        size_t stackSize;
+    };
+
+    /**
+     * Minimal number of samples before a stack size is recommended.
+     */
+    static constexpr uint64_t minSamples = 16;
+
+    /**
+     * Records a run of the task with the given path.
+     */
+    void record(const Path& path, size_t used, size_t stackSize);
+
+    /**
+     * Returns the usage of all names.
+     */
+    std::map<std::string, Usage> usage() const;
+
+    /**
+     * Returns the stack size for tasks with the given path, twice the peak usage, or 0 if there
+     * are not enough samples yet.
+     */
+    size_t recommended(const Path& path) const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, Usage> usage_;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_STACKPROFILE_HPP
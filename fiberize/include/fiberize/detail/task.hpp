@@ -8,15 +8,18 @@
 #define FIBERIZE_DETAIL_TASK_HPP
 
 #include <fiberize/path.hpp>
+#include <fiberize/priority.hpp>
 #include <fiberize/mailbox.hpp>
 #include <fiberize/fiberref.hpp>
 #include <fiberize/promise.hpp>
 #include <fiberize/spinlock.hpp>
+#include <fiberize/detail/context.hpp>
 #include <fiberize/detail/runnable.hpp>
 #include <fiberize/detail/refrencecounted.hpp>
 
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 
@@ -31,6 +34,8 @@ class Scheduler;
 
 namespace detail {
 
+struct SchedulerPool;
+
 /**
  * @defgroup lifecycle Schedulers and lifecycle of a task
  *
@@ -96,10 +101,20 @@ public:
     Task()
         : status(Starting)
         , scheduled(false)
+        , preferred(nullptr)
+        , lastScheduler(nullptr)
+        , pool(nullptr)
         , handlersInitialized(false)
         , resumes(0)
         , stopped(false)
         , refCount(0)
+        , priority(Priority::Normal)
+        , deadline(0)
+        , baseDeadline(0)
+        , stackSize(0)
+        , integerOnly(false)
+        , nonBlockingHandlers(false)
+        , coroutine(false)
         {}
 
     virtual ~Task() {}
@@ -128,6 +143,22 @@ public:
      * Scheduler this task is pinned to, or nullptr.
      */
     Scheduler* pin;
+
+    /**
+     * Scheduler this task prefers to run on, or nullptr. Unlike the pin this is only a hint,
+     * other schedulers can take the task when the preferred one is busy.
+     */
+    Scheduler* preferred;
+
+    /**
+     * Multitasking scheduler that ran this task most recently, or nullptr. Updated under the spinlock.
+     */
+    Scheduler* lastScheduler;
+
+    /**
+     * Named pool of schedulers this task runs in, or nullptr for the default pool.
+     */
+    SchedulerPool* pool;
     
     /**
      * Whether the standard event handlers were initialized.
@@ -137,7 +168,12 @@ public:
     /**
      * The last saved context.
      */
-    boost::context::fcontext_t context;
+    Context context;
+
+    /**
+     * The stack this task runs on, valid while the task is running or suspended.
+     */
+    boost::context::stack_context stack;
 
     /**
      * Tracks how many times there was an attempt to resume this task.
@@ -159,6 +195,56 @@ public:
      */
     uint32_t refCount;
 
+    /**
+     * Priority class of this task.
+     */
+    Priority priority;
+
+    /**
+     * The earliest deadline of the task and its pending events, 0 if there is none.
+     */
+    std::atomic<uint64_t> deadline;
+
+    /**
+     * Deadline of the task itself, restored when the mailbox is drained.
+     */
+    uint64_t baseDeadline;
+
+    /**
+     * Size of the stack this task needs, or 0 for the default size.
+     */
+    size_t stackSize;
+
+    /**
+     * Whether the task leaves the floating point control registers alone, so that switching
+     * to and from it doesn't have to restore them.
+     */
+    bool integerOnly;
+
+    /**
+     * Whether the handlers of this task never suspend, so that it can process events on a stack
+     * it doesn't own.
+     */
+    bool nonBlockingHandlers;
+
+    /**
+     * Whether the task is a coroutine. A coroutine listens from the start and the runnable takes it
+     * from one suspension point to the next, each time the task is scheduled.
+     */
+    bool coroutine;
+
+    /**
+     * Makes the deadline earlier, if the given one is earlier. Requires the spinlock.
+     * @returns whether the deadline changed.
+     */
+    inline bool tightenDeadline(uint64_t value) {
+        uint64_t current = deadline.load(std::memory_order_relaxed);
+        if (current != 0 && value >= current)
+            return false;
+        deadline.store(value, std::memory_order_relaxed);
+        return true;
+    }
+
     /**
      * Hash map of event handlers.
      */
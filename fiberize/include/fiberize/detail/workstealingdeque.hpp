@@ -0,0 +1,204 @@
+/**
+ * Lock-free work stealing deque.
+ *
+ * @file workstealingdeque.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_DETAIL_WORKSTEALINGDEQUE_HPP
+#define FIBERIZE_DETAIL_WORKSTEALINGDEQUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * Chase-Lev work stealing deque.
+ *
+ * The owner pushes and pops values at the bottom of the deque (LIFO), while other threads
+ * steal values from the top (FIFO). None of the operations take a lock. The buffer grows
+ * when the deque is full, old buffers are kept until the deque is destroyed, because
+ * thieves might still be reading from them.
+ *
+ * @see Lê, Nhat Minh, et al. "Correct and efficient work-stealing for weak memory models."
+ *      ACM SIGPLAN Notices 48.8 (2013): 69-80.
+ *
+ * @tparam A A trivially copyable value type, usually a pointer.
+ */
+template <typename A>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 256)
+        : top(0), bottom(0) {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        buffers.emplace_back(new Buffer(size));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator = (const WorkStealingDeque&) = delete;
+
+    /**
+     * Pushes a value at the bottom of the deque.
+     * @note Can only be called by the owner.
+     */
+    void push(A value) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+
+        if (b - t > int64_t(buf->mask)) {
+            buf = grow(buf, b, t);
+        }
+
+        buf->put(b, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Pops a value from the bottom of the deque.
+     * @returns whether a value was popped.
+     * @note Can only be called by the owner.
+     */
+    bool pop(A& value) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // The deque was empty.
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        A candidate = buf->get(b);
+        if (t == b) {
+            // This is the last value, we have to race with the thieves.
+            bool won = top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won)
+                return false;
+        }
+
+        value = candidate;
+        return true;
+    }
+
+    /**
+     * Steals a value from the top of the deque.
+     * @returns whether a value was stolen.
+     * @note Thread-safe.
+     */
+    bool steal(A& value) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return false;
+
+        Buffer* buf = buffer.load(std::memory_order_acquire);
+        A candidate = buf->get(t);
+        if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+
+        value = candidate;
+        return true;
+    }
+
+    /**
+     * Steals up to half of the values in the deque, but not more than max, oldest first.
+     * @returns the number of stolen values.
+     * @note Thread-safe.
+     *
+     * The owner pops values without synchronizing with the thieves, unless it takes the
+     * last one, so a range of values cannot be reserved with a single update of the top.
+     * Instead the values are claimed one by one. After the first successful claim the top
+     * stays in the thief's cache, so the following ones are cheap.
+     */
+    size_t stealHalf(A* values, size_t max) {
+        size_t count = std::min((size() + 1) / 2, max);
+        size_t stolen = 0;
+        while (stolen < count && steal(values[stolen])) {
+            stolen += 1;
+        }
+        return stolen;
+    }
+
+    /**
+     * Approximate number of values in the deque.
+     * @note Thread-safe, but the result might be stale.
+     */
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? size_t(b - t) : 0;
+    }
+
+    /**
+     * Whether the deque looks empty.
+     * @note Thread-safe, but the result might be stale.
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Buffer {
+        explicit Buffer(size_t size)
+            : mask(size - 1), values(new std::atomic<A>[size]) {}
+
+        A get(int64_t index) const {
+            return values[index & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t index, A value) {
+            values[index & mask].store(value, std::memory_order_relaxed);
+        }
+
+        const size_t mask;
+        std::unique_ptr<std::atomic<A>[]> values;
+    };
+
+    Buffer* grow(Buffer* old, int64_t b, int64_t t) {
+        std::unique_ptr<Buffer> bigger(new Buffer((old->mask + 1) * 2));
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+
+        Buffer* result = bigger.get();
+        buffers.emplace_back(std::move(bigger));
+        buffer.store(result, std::memory_order_release);
+        return result;
+    }
+
+    /**
+     * Top and bottom live on separate cache lines. Only the thieves and the owner popping
+     * the last value write to the top, only the owner writes to the bottom.
+     */
+    std::atomic<int64_t> top;
+    char padding[64];
+    std::atomic<int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+
+    /**
+     * All buffers ever used by this deque. Accessed only by the owner.
+     */
+    std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_DETAIL_WORKSTEALINGDEQUE_HPP
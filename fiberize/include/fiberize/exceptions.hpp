@@ -2,6 +2,7 @@
 #define FIBERIZE_EXCEPTIONS_HPP
 
 #include <stdexcept>
+#include <string>
 
 namespace fiberize {
 
@@ -27,6 +28,28 @@ public:
     NullAwaitable(NullAwaitable&&) = default;
 };
 
+/**
+ * Thrown when a task is started in a scheduler pool that doesn't exist.
+ */
+class UnknownPool : public std::runtime_error {
+public:
+    explicit UnknownPool(const std::string& pool);
+
+    UnknownPool(const UnknownPool&) = default;
+    UnknownPool(UnknownPool&&) = default;
+};
+
+/**
+ * Thrown when a sharded fiber system is resized, which would remap the keys to different shards.
+ */
+class ShardedResize : public std::runtime_error {
+public:
+    explicit ShardedResize();
+
+    ShardedResize(const ShardedResize&) = default;
+    ShardedResize(ShardedResize&&) = default;
+};
+
 } // namespace fiberize
 
 #endif // FIBERIZE_EXCEPTIONS_HPP
@@ -7,6 +7,8 @@
 
 #include <fiberize/locality.hpp>
 #include <fiberize/path.hpp>
+#include <fiberize/placement.hpp>
+#include <fiberize/priority.hpp>
 #include <fiberize/handler.hpp>
 #include <fiberize/mailbox.hpp>
 #include <fiberize/result.hpp>
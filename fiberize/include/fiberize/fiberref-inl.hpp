@@ -3,22 +3,64 @@
 
 #include <fiberize/fiberref.hpp>
 #include <fiberize/event.hpp>
+#include <fiberize/context.hpp>
 
 namespace fiberize {
 
+namespace detail {
+
+/**
+ * Builds a pending event holding a new value of the event's type.
+ */
+template <typename A, typename... Args>
+PendingEvent makePendingEvent(const Event<A>& event, Args&&... args) {
+    PendingEvent pendingEvent;
+    pendingEvent.path = event.path();
+    pendingEvent.data = new A(std::forward<Args>(args)...);
+    pendingEvent.freeData = [] (void* data) { delete reinterpret_cast<A*>(data); };
+    return pendingEvent;
+}
+
+/**
+ * Builds a pending event without a value.
+ */
+inline PendingEvent makePendingEvent(const Event<void>& event) {
+    PendingEvent pendingEvent;
+    pendingEvent.path = event.path();
+    pendingEvent.data = nullptr;
+    pendingEvent.freeData = nullptr;
+    return pendingEvent;
+}
+
+} // namespace detail
+
 template<typename A, typename... Args>
 void FiberRef::send(const Event<A>& event, Args&&... args) const {
-    if (impl_->locality() != DevNull && event.path() != Path(DevNullPath{})) {
-        PendingEvent pendingEvent;
-        pendingEvent.path = event.path();
-        pendingEvent.data = new A(std::forward<Args>(args)...);
-        pendingEvent.freeData = [] (void* data) { delete reinterpret_cast<A*>(data); };
+    emit([this] (const PendingEvent& pendingEvent) {
         impl_->send(pendingEvent);
-    }
+    }, event, std::forward<Args>(args)...);
 }
 
-template <>
-void FiberRef::send<void>(const Event<void>& event) const;
+template<typename A, typename... Args>
+void FiberRef::sendAndSwitch(const Event<A>& event, Args&&... args) const {
+    emit([this] (const PendingEvent& pendingEvent) {
+        impl_->sendAndSwitch(pendingEvent);
+    }, event, std::forward<Args>(args)...);
+}
+
+template<typename A, typename... Args>
+void FiberRef::sendWithDeadline(Deadline deadline, const Event<A>& event, Args&&... args) const {
+    emit([this, deadline] (const PendingEvent& pendingEvent) {
+        impl_->sendWithDeadline(pendingEvent, detail::deadlineValue(deadline));
+    }, event, std::forward<Args>(args)...);
+}
+
+template<typename Emit, typename A, typename... Args>
+void FiberRef::emit(Emit emit, const Event<A>& event, Args&&... args) const {
+    if (impl_->locality() != DevNull && event.path() != Path(DevNullPath{}))
+        emit(detail::makePendingEvent(event, std::forward<Args>(args)...));
+    context::checkpoint();
+}
 
 } // namespace fiberize
 
@@ -5,6 +5,7 @@
 #include <fiberize/events.hpp>
 #include <fiberize/mailbox.hpp>
 #include <fiberize/locality.hpp>
+#include <fiberize/priority.hpp>
 #include <fiberize/detail/fiberrefimpl.hpp>
 #include <fiberize/detail/devnullfiberref.hpp>
 
@@ -66,6 +67,21 @@ public:
     template<typename A, typename... Args>
     void send(const Event<A>& event, Args&&... args) const;
 
+    /**
+     * Emits an event and, if the receiver is a suspended local fiber that can run on this scheduler,
+     * switches to it immediately instead of waiting for the current fiber to suspend. The current
+     * fiber is rescheduled. Useful for request/response exchanges.
+     */
+    template<typename A, typename... Args>
+    void sendAndSwitch(const Event<A>& event, Args&&... args) const;
+
+    /**
+     * Emits an event that should be handled by the given deadline. Until the receiver drains its
+     * mailbox, it is scheduled earliest deadline first.
+     */
+    template<typename A, typename... Args>
+    void sendWithDeadline(Deadline deadline, const Event<A>& event, Args&&... args) const;
+
     /**
      * The internal implementation.
      */
@@ -75,6 +91,13 @@ public:
 
 protected:
     std::shared_ptr<detail::FiberRefImpl> impl_;
+
+private:
+    /**
+     * Builds the pending event and hands it to emit, unless this fiber or the event is /dev/null.
+     */
+    template<typename Emit, typename A, typename... Args>
+    void emit(Emit emit, const Event<A>& event, Args&&... args) const;
 };
 
 template <typename A>
@@ -123,6 +146,13 @@ public:
         return futureImpl_->await();
     }
 
+    /**
+     * The promise holding the result of this future, or nullptr if await() never blocks.
+     */
+    Promise<Result<A>>* promise() const {
+        return futureImpl_->promise();
+    }
+
 private:
     detail::FutureRefImpl<A>* futureImpl_;
 };
@@ -1,17 +1,25 @@
 #ifndef FIBERIZE_FIBERSYSTEM_HPP
 #define FIBERIZE_FIBERSYSTEM_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <type_traits>
 
 #include <boost/context/all.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/type_traits.hpp>
 
 #include <fiberize/promise.hpp>
+#include <fiberize/fibersystemconfig.hpp>
 #include <fiberize/builder.hpp>
 #include <fiberize/fiberref.hpp>
 #include <fiberize/scheduler.hpp>
 #include <fiberize/context.hpp>
+#include <fiberize/coroutine.hpp>
 #include <fiberize/detail/task.hpp>
 #include <fiberize/detail/localfiberref.hpp>
 #include <fiberize/detail/devnullfiberref.hpp>
@@ -24,6 +32,11 @@ namespace fiberize {
 namespace detail {
 
 class MultiTaskScheduler;
+class IdleWorkers;
+class SchedulerThreads;
+class StackPool;
+class StackProfile;
+struct SchedulerPool;
 
 } // namespace detail
 
@@ -38,6 +51,11 @@ public:
      * Starts the system with the given number of macrothreads.
      */
     FiberSystem(uint32_t macrothreads);
+
+    /**
+     * Starts the system with the given configuration.
+     */
+    explicit FiberSystem(const FiberSystemConfig& config);
     
     /**
      * Cleans up the main fiber.
@@ -95,6 +113,26 @@ public:
         );
     }
 
+#ifdef FIBERIZE_COROUTINES
+    /**
+     * Creates a new coroutine builder using the given function returning a Coroutine and optionally
+     * a mailbox. The coroutine runs as a stackless future, its reference is a FutureRef.
+     * By default the coroutine is unnamed, not pinned and has a DequeMailbox.
+     */
+    template <typename Function, typename MailboxType = DequeMailbox>
+    Builder<detail::CoroutineTraits, Function, DequeMailbox>
+    coroutine(Function function, MailboxType mailbox = {}) {
+        static_assert(std::is_move_constructible<Function>{}, "Function must be move constructible.");
+        return Builder<detail::CoroutineTraits, Function, DequeMailbox>(
+            boost::none,
+            std::move(function),
+            std::move(mailbox),
+            nullptr,
+            detail::runTaskAsMicrothread
+        );
+    }
+#endif
+
     /**
      * Shut down the system.
      */
@@ -137,15 +175,166 @@ public:
     }
 
     /**
-     * Returns a vector of fiber schedulers.
+     * Returns a vector of the active fiber schedulers. The vector is a snapshot, it doesn't change
+     * when the system is resized and stays valid until the system is destroyed.
+     */
+    inline const std::vector<detail::MultiTaskScheduler*>& schedulers() const {
+        return *schedulers_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the schedulers of the named pool.
+     * @throws UnknownPool if there is no such pool.
+     */
+    const std::vector<detail::MultiTaskScheduler*>& schedulers(const std::string& pool);
+
+    /**
+     * Returns the schedulers of the given pool, or the active schedulers of the default pool if it is nullptr.
+     */
+    const std::vector<detail::MultiTaskScheduler*>& schedulersIn(const detail::SchedulerPool* pool) const;
+
+    /**
+     * Finds a named pool.
+     * @throws UnknownPool if there is no such pool.
+     */
+    detail::SchedulerPool* pool(const std::string& name);
+
+    /**
+     * Number of shards of a sharded system, that is the number of macrothreads in the default pool.
+     * @see FiberSystemConfig::sharded
+     */
+    inline uint32_t shards() const { return schedulers().size(); }
+
+    /**
+     * Returns the macrothread running the given shard.
+     * @throws std::out_of_range if there is no such shard.
+     */
+    Scheduler* shard(uint32_t index) const;
+
+    /**
+     * Maps a key to a shard. A key always maps to the same shard, as long as the number of shards doesn't change.
+     */
+    template <typename Key>
+    uint32_t shardOf(const Key& key) const {
+        return boost::hash<Key>()(key) % shards();
+    }
+
+    /**
+     * Changes the number of macrothreads, at least one is always kept. Retired macrothreads hand their
+     * tasks over to the active ones and sleep, but still run tasks pinned to them. Growing the system
+     * reactivates retired macrothreads before starting new ones.
+     * @throws ShardedResize if the system is sharded, the number of shards never changes.
+     * @note Thread-safe.
+     */
+    void resize(uint32_t macrothreads);
+
+    /**
+     * Returns the configuration of this system. The topology is always set.
+     */
+    inline const FiberSystemConfig& config() const { return config_; }
+
+    /**
+     * Returns the registry of spinning and parked schedulers.
+     */
+    inline detail::IdleWorkers& idleWorkers() { return *idleWorkers_; }
+
+    /**
+     * Returns the pool of unused microthread stacks.
      */
-    inline const std::vector<detail::MultiTaskScheduler*>& schedulers() { return schedulers_; }
+    inline detail::StackPool& stackPool() { return *stackPool_; }
+
+    /**
+     * Returns the measured stack usage of the tasks.
+     * @see FiberSystemConfig::stackProfiling
+     */
+    inline detail::StackProfile& stackProfile() { return *stackProfile_; }
+
+    /**
+     * Threads running the multitasking schedulers.
+     */
+    inline detail::SchedulerThreads& schedulerThreads() { return *schedulerThreads_; }
 
 private:
     /**
-     * Currently running schedulers.
+     * Makes the given schedulers active. Requires the resize mutex.
+     */
+    void publish(std::vector<detail::MultiTaskScheduler*> active);
+
+    /**
+     * Changes the number of macrothreads, even if the system is sharded.
+     */
+    void setMacrothreads(uint32_t macrothreads);
+
+    /**
+     * Body of the monitor thread, which drives preemption and auto-scaling.
+     */
+    void monitor();
+
+    /**
+     * Grows or shrinks the system once, according to the current load.
+     */
+    void autoScale(uint32_t& idleSamples);
+
+    /**
+     * Configuration of the system.
+     */
+    FiberSystemConfig config_;
+
+    /**
+     * Currently active schedulers.
+     */
+    std::atomic<const std::vector<detail::MultiTaskScheduler*>*> schedulers_;
+
+    /**
+     * A published set of active schedulers and the steal victims of each of them.
+     */
+    struct Snapshot {
+        std::vector<detail::MultiTaskScheduler*> schedulers;
+        std::vector<std::unique_ptr<const std::vector<std::vector<detail::MultiTaskScheduler*>>>> victims;
+    };
+
+    /**
+     * Published snapshots, indexed by the number of active schedulers. Readers don't synchronize
+     * with resize, so a snapshot is kept until the system is destroyed. The active schedulers of
+     * a given size are always the same, so the snapshot of each size is created once and reused.
+     */
+    std::vector<std::unique_ptr<Snapshot>> snapshots_;
+
+    /**
+     * Every scheduler ever created, in the order of creation, and the retired ones.
+     */
+    std::vector<detail::MultiTaskScheduler*> allSchedulers_;
+    std::vector<detail::MultiTaskScheduler*> retired_;
+    std::mutex resizeMutex_;
+
+    /**
+     * Named pools, fixed when the system starts.
+     */
+    std::vector<std::unique_ptr<detail::SchedulerPool>> pools_;
+
+    /**
+     * Monitor thread.
+     */
+    std::thread monitor_;
+    std::mutex monitorMutex_;
+    std::condition_variable monitorCondition_;
+    bool monitorStopping_;
+
+    /**
+     * Unused microthread stacks. Destroyed after the schedulers.
+     */
+    std::unique_ptr<detail::StackPool> stackPool_;
+    std::unique_ptr<detail::StackProfile> stackProfile_;
+
+    /**
+     * Spinning and parked schedulers.
+     */
+    std::unique_ptr<detail::IdleWorkers> idleWorkers_;
+
+    /**
+     * Threads running the multitasking schedulers.
      */
-    std::vector<detail::MultiTaskScheduler*> schedulers_;
+    std::unique_ptr<detail::SchedulerThreads> schedulerThreads_;
     
     /**
      * The prefix of this actor system.
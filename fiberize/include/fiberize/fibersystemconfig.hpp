@@ -0,0 +1,271 @@
+/**
+ * Configuration of a fiber system.
+ *
+ * @file fibersystemconfig.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_FIBERSYSTEMCONFIG_HPP
+#define FIBERIZE_FIBERSYSTEMCONFIG_HPP
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include <fiberize/path.hpp>
+#include <fiberize/placement.hpp>
+#include <fiberize/topology.hpp>
+
+namespace fiberize {
+
+/**
+ * How long running tasks are asked to yield.
+ */
+enum class Preemption : uint8_t {
+    /**
+     * Tasks run until they suspend.
+     */
+    Disabled,
+
+    /**
+     * A monitor thread sets a flag checked at safepoints: send, event processing and context::checkpoint().
+     */
+    Flag,
+
+    /**
+     * Like Flag, but the flag is set by a signal delivered to the scheduler thread.
+     */
+    Signal
+};
+
+/**
+ * Where an unpinned task goes when it is resumed.
+ */
+enum class WakePolicy : uint8_t {
+    /**
+     * To the scheduler of the resuming task, or a random one if it is resumed from outside of the macrothreads.
+     */
+    Local,
+
+    /**
+     * To a random scheduler.
+     */
+    Random,
+
+    /**
+     * To the scheduler that ran the task last time, so its data is still in the cache, unless that
+     * scheduler is overloaded. Falls back to Local.
+     */
+    Last
+};
+
+/**
+ * Parameters of a FiberSystem. The default constructed configuration matches the behaviour
+ * of the default FiberSystem constructor.
+ */
+struct FiberSystemConfig {
+    /**
+     * Creates the default configuration.
+     */
+    FiberSystemConfig();
+
+    /**
+     * Number of macrothreads (multitasking schedulers). Defaults to the number of available CPUs.
+     */
+    uint32_t macrothreads;
+
+    /**
+     * Topology of the machine. Discovered from sysfs if not set.
+     */
+    boost::optional<Topology> topology;
+
+    /**
+     * Whether to pin each macrothread to a CPU. Threads are spread over physical cores first.
+     * @note Defaults to false.
+     */
+    bool pinThreads;
+
+    /**
+     * Whether pinned macrothreads should steal from the closest schedulers first: SMT siblings,
+     * then schedulers sharing the last level cache, then the same NUMA node and finally remote nodes.
+     * Has no effect if the threads are not pinned.
+     * @note Defaults to true.
+     */
+    bool topologyAwareStealing;
+
+    /**
+     * Whether a thief takes up to half of the victim's tasks at once, instead of a single one.
+     * @note Defaults to true.
+     */
+    bool stealHalf;
+
+    /**
+     * Whether to adjust the number of macrothreads to the load. The system grows when no macrothread
+     * is idle and tasks are piling up in the queues, and shrinks when some macrothreads stay idle.
+     * @note Defaults to false.
+     */
+    bool autoScale;
+
+    /**
+     * The smallest number of macrothreads auto-scaling shrinks to.
+     * @note Defaults to 1.
+     */
+    uint32_t minMacrothreads;
+
+    /**
+     * The largest number of macrothreads auto-scaling grows to.
+     * @note Defaults to the number of available CPUs.
+     */
+    uint32_t maxMacrothreads;
+
+    /**
+     * How often auto-scaling looks at the load.
+     * @note Defaults to 100ms.
+     */
+    std::chrono::milliseconds autoScaleInterval;
+
+    /**
+     * How long running tasks are asked to yield. With preemption every send is a safepoint,
+     * so a task can be suspended in the middle of a send.
+     * @note Defaults to Preemption::Disabled.
+     */
+    Preemption preemption;
+
+    /**
+     * How long a task can run before it is asked to yield at the next safepoint.
+     * @note Defaults to 10ms.
+     */
+    std::chrono::microseconds timeSlice;
+
+    /**
+     * Signal used by Preemption::Signal.
+     * @note Defaults to SIGURG.
+     */
+    int preemptionSignal;
+
+    /**
+     * Tasks running longer than this without a break are reported to the overrun handler.
+     * @note Defaults to 100ms.
+     */
+    std::chrono::microseconds overrunThreshold;
+
+    /**
+     * Called on the scheduler thread with the path of a task that exceeded the overrun threshold
+     * and the time it was running. Can be empty.
+     * @note Defaults to an empty handler, overruns are not reported.
+     */
+    std::function<void (const Path&, std::chrono::nanoseconds)> overrunHandler;
+
+    /**
+     * Whether a macrothread blocked by context::blocking() or a Block mode IO operation hands its
+     * scheduler over to a standby thread, so that the other tasks keep running. Enabling it starts
+     * the monitor thread.
+     * @note Defaults to false.
+     */
+    bool blockingHandoff;
+
+    /**
+     * How long a blocking call can take before the scheduler is handed over. Shorter calls
+     * don't pay for the handoff.
+     * @note Defaults to 1ms.
+     */
+    std::chrono::microseconds blockingHandoffDelay;
+
+    /**
+     * How long a task waiting for the scheduler it prefers is kept away from thieves.
+     * @see Builder::preferred
+     * @note Defaults to 100us.
+     */
+    std::chrono::microseconds preferredStealDelay;
+
+    /**
+     * How many tasks can wait for the scheduler they prefer before thieves take them
+     * regardless of the delay.
+     * @note Defaults to 16.
+     */
+    uint32_t preferredStealDepth;
+
+    /**
+     * Where resumed unpinned tasks go. Tasks with a preferred scheduler always go there.
+     * @note Defaults to WakePolicy::Local.
+     */
+    WakePolicy wakePolicy;
+
+    /**
+     * With WakePolicy::Last, the number of waiting tasks at which a scheduler counts as overloaded.
+     * @note Defaults to 64.
+     */
+    uint32_t wakeLoadLimit;
+
+    /**
+     * Where new unpinned tasks are queued, unless their builder says otherwise.
+     * @note Defaults to Placement::Local.
+     */
+    Placement placement;
+
+    /**
+     * Named pools of macrothreads and their sizes, in addition to the default pool of macrothreads.
+     * Tasks started in a pool with Builder::inPool run only on its macrothreads, which steal only
+     * from each other. Named pools are not resized.
+     * @note Defaults to no named pools.
+     */
+    std::map<std::string, uint32_t> pools;
+
+    /**
+     * Whether to run the default pool as a set of shared-nothing shards, one per macrothread.
+     * Every microthread started in the default pool is pinned to the shard that started it,
+     * or to FiberSystem::shardOf its path if it was started outside of the shards, and the
+     * macrothreads never steal from each other. Tasks resumed from another shard are passed
+     * through the inbox of that pair of shards. Auto-scaling is turned off, so that keys keep
+     * mapping to the same shards.
+     * @see FiberSystem::shard, FiberSystem::shardOf, Builder::onShard
+     * @note Defaults to false.
+     */
+    bool sharded;
+
+    /**
+     * Number of unused stacks the shared stack pool keeps ready. The unused pages of stacks
+     * returned above this number are given back to the OS, but the stacks stay mapped.
+     * @note Defaults to 256.
+     */
+    uint64_t stackPoolLowWatermark;
+
+    /**
+     * Largest number of unused stacks in the shared stack pool. Stacks returned above this
+     * number are unmapped.
+     * @note Defaults to 4096.
+     */
+    uint64_t stackPoolHighWatermark;
+
+    /**
+     * Whether to put an inaccessible guard page below every microthread stack. A task overflowing
+     * its stack is then reported with its path and stack size, and the process aborts, instead of
+     * silently corrupting memory. Each guarded stack takes two memory mappings, so past a quarter of
+     * the kernel's limit (vm.max_map_count) new stacks are left unguarded.
+     * @note Defaults to true.
+     */
+    bool stackGuardPages;
+
+    /**
+     * Whether to measure how much stack the tasks use. New stacks are painted with a canary pattern
+     * and the high-water mark is taken after each run of a task, per task name.
+     * Painted stacks are never given back to the OS by the stack pool.
+     * @see FiberSystem::stackProfile
+     * @note Defaults to false.
+     */
+    bool stackProfiling;
+
+    /**
+     * Whether tasks without an explicit stack size get twice the peak stack usage measured for their
+     * name, once enough runs were measured. Requires stackProfiling. Guard pages are recommended,
+     * a task can still need more than it ever used before.
+     * @note Defaults to false.
+     */
+    bool stackRightSizing;
+};
+
+} // namespace fiberize
+
+#endif // FIBERIZE_FIBERSYSTEMCONFIG_HPP
@@ -31,6 +31,17 @@ public:
      */
     void throttledPoll();
 
+    /**
+     * Run the event loop once, blocking until an event arrives or wakeup() is called.
+     */
+    void wait();
+
+    /**
+     * Interrupts wait(). If the loop is not waiting, the next call to wait() returns immediately.
+     * @note Thread-safe.
+     */
+    void wakeup();
+
     /**
      * Returns the libuv loop associated with this IO context.
      */
@@ -38,6 +49,7 @@ public:
 
 private:
     uv_loop_t loop_;
+    uv_async_t wakeup_;
     uint64_t lastRun;
 };
 
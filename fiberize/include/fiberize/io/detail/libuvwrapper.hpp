@@ -345,9 +345,13 @@ struct LibUVWrapper {
         Env env;
 
         /**
-         * Do the IO operation.
+         * Do the IO operation. Without a callback libuv doesn't touch the loop, so the scheduler
+         * can run on another thread in the meantime.
          */
-        int code = uvfunction(Scheduler::current()->ioContext().loop(), &env.request, std::forward<Args>(args)..., nullptr);
+        uv_loop_t* loop = Scheduler::current()->ioContext().loop();
+        int code = context::blocking([&] () {
+            return uvfunction(loop, &env.request, std::forward<Args>(args)..., nullptr);
+        });
 
         /**
          * There are two ways an error could be reported: the returned code or req.result. Check them.
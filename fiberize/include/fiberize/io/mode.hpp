@@ -28,7 +28,8 @@ namespace io {
  *   - Await - Executing an IO operation in await mode will block the fiber until the operation is done,
  *             while processing messages and allowing other fibers to execute. This mode is usually the default.
  *   - Block - Exeuting an IO operation in block mode will block the fiber and the thread it is executing on.
- *             This version does not process messages and does not allow other fibers to execute on this core.
+ *             This version does not process messages. If the operation takes long, the scheduler is handed
+ *             over to another thread, so that other fibers can execute on this core.
  *   - Async - Executing an IO operation in defer mode won't block the fiber and won't process messages.
  *             Instead it starts the IO operation asynchronously and reports the result with an event.
  *
@@ -66,7 +67,8 @@ class Await {};
 
 /**
  * Exeuting an IO operation in block mode will block the fiber and the thread it is executing on.
- * This version does not process messages and does not allow other fibers to execute on this core.
+ * This version does not process messages. If the operation takes longer than
+ * FiberSystemConfig::blockingHandoffDelay, the scheduler is handed over to another thread.
  *
  * This mode should be used for inexpensive and predictable IO operations, especially filesystem
  * operations. Asynchronous FS operations are currently implemented with a worker pool. The cost
@@ -0,0 +1,41 @@
+/**
+ * Placement of newly spawned tasks.
+ *
+ * @file placement.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_PLACEMENT_HPP
+#define FIBERIZE_PLACEMENT_HPP
+
+#include <cstdint>
+
+namespace fiberize {
+
+/**
+ * Chooses the macrothread a new unpinned task is queued on. Other macrothreads can still steal it.
+ */
+enum class Placement : uint8_t {
+    /**
+     * The spawning macrothread, or a random one if the task is spawned from outside of the macrothreads.
+     */
+    Local,
+
+    /**
+     * The macrothreads in turn.
+     */
+    RoundRobin,
+
+    /**
+     * The less loaded of two random macrothreads.
+     */
+    LeastLoaded,
+
+    /**
+     * A macrothread chosen by the hash of the task's path, so tasks with the same name land together.
+     */
+    Hashed
+};
+
+} // namespace fiberize
+
+#endif // FIBERIZE_PLACEMENT_HPP
@@ -0,0 +1,63 @@
+/**
+ * Task priority classes and deadlines.
+ *
+ * @file priority.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_PRIORITY_HPP
+#define FIBERIZE_PRIORITY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace fiberize {
+
+/**
+ * Priority class of a task. Schedulers run tasks of higher classes first, but tasks of lower
+ * classes age while they wait, so they are delayed and never starved.
+ */
+enum class Priority : uint8_t {
+    /**
+     * Latency critical tasks, like control plane actors.
+     */
+    Critical = 0,
+
+    /**
+     * Regular tasks.
+     * @note This is the default.
+     */
+    Normal = 1,
+
+    /**
+     * Bulk work, which runs when nothing more important is waiting.
+     */
+    Background = 2
+};
+
+/**
+ * Number of priority classes.
+ */
+constexpr size_t priorityClasses = 3;
+
+/**
+ * Point in time by which a task should run. Tasks with a deadline are scheduled earliest deadline
+ * first, after critical tasks and before normal ones.
+ */
+using Deadline = std::chrono::steady_clock::time_point;
+
+namespace detail {
+
+/**
+ * Converts a deadline to the representation used by the schedulers, where 0 means no deadline.
+ */
+inline uint64_t deadlineValue(Deadline deadline) {
+    auto value = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    return value > 0 ? uint64_t(value) : 1;
+}
+
+} // namespace detail
+
+} // namespace fiberize
+
+#endif // FIBERIZE_PRIORITY_HPP
@@ -102,6 +102,33 @@ public:
         return result.get().copy();
     }
 
+    /**
+     * Makes the current task resumed when the promise completes, without suspending it.
+     * Used by tasks that can't suspend, like coroutines.
+     * @returns the ticket of the task, or 0 if the promise is already complete.
+     */
+    uint64_t subscribe() {
+        std::unique_lock<Spinlock> lock(spinlock);
+        if (result)
+            return 0;
+        return completed.subscribe(lock);
+    }
+
+    /**
+     * Whether the promise completed, as seen by the holder of the given ticket.
+     */
+    bool signaled(uint64_t ticket) const {
+        return ticket == 0 || completed.signaled(ticket);
+    }
+
+    /**
+     * Withdraws the given ticket, if the promise didn't complete yet.
+     */
+    void unsubscribe(uint64_t ticket) {
+        std::unique_lock<Spinlock> lock(spinlock);
+        completed.unsubscribe(ticket, lock);
+    }
+
 private:
     HandlerRef handler;
     Condition completed;
@@ -0,0 +1,130 @@
+/**
+ * CPU topology discovery.
+ *
+ * @file topology.hpp
+ * @copyright 2015 Paweł Nowak
+ */
+#ifndef FIBERIZE_TOPOLOGY_HPP
+#define FIBERIZE_TOPOLOGY_HPP
+
+#include <cinttypes>
+#include <limits>
+#include <vector>
+
+namespace fiberize {
+
+/**
+ * How far apart two logical CPUs are, from the closest to the farthest.
+ */
+enum CpuDistance : uint8_t {
+    /**
+     * The same logical CPU.
+     */
+    SameCpu = 0,
+
+    /**
+     * Hyperthreads of the same physical core.
+     */
+    SmtSibling = 1,
+
+    /**
+     * Different cores sharing the last level cache.
+     */
+    SharedCache = 2,
+
+    /**
+     * Different caches on the same NUMA node.
+     */
+    SameNode = 3,
+
+    /**
+     * Different NUMA nodes.
+     */
+    RemoteNode = 4
+};
+
+/**
+ * A logical CPU.
+ */
+struct Cpu {
+    /**
+     * Value used when some property of a CPU is unknown.
+     */
+    static constexpr uint32_t unknown = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * Logical CPU number, as used by the OS.
+     */
+    uint32_t id;
+
+    /**
+     * Core id, unique within a package.
+     */
+    uint32_t core;
+
+    /**
+     * Physical package (socket) id.
+     */
+    uint32_t package;
+
+    /**
+     * NUMA node.
+     */
+    uint32_t node;
+
+    /**
+     * Identifier of the last level cache, the lowest CPU number sharing it.
+     */
+    uint32_t cache;
+};
+
+/**
+ * Layout of the CPUs available to this process.
+ */
+class Topology {
+public:
+    /**
+     * Creates an empty topology.
+     */
+    Topology() = default;
+
+    /**
+     * Creates a topology from the given CPUs.
+     */
+    explicit Topology(std::vector<Cpu> cpus);
+
+    /**
+     * Reads the topology from sysfs. Only CPUs in the affinity mask of this process are included.
+     * If sysfs is not available returns a flat topology with std::thread::hardware_concurrency() CPUs.
+     */
+    static Topology discover();
+
+    /**
+     * Creates a topology of the given number of CPUs, without any information about their layout.
+     */
+    static Topology flat(uint32_t cpus);
+
+    /**
+     * The available CPUs, sorted by id.
+     */
+    inline const std::vector<Cpu>& cpus() const { return cpus_; }
+
+    /**
+     * Computes the distance between two CPUs.
+     */
+    static CpuDistance distance(const Cpu& a, const Cpu& b);
+
+    /**
+     * Chooses CPUs for the given number of threads. Threads are spread over physical cores first,
+     * the second hyperthread of a core is used only when all cores are taken. If there are more
+     * threads than CPUs the placement wraps around.
+     */
+    std::vector<Cpu> placement(uint32_t threads) const;
+
+private:
+    std::vector<Cpu> cpus_;
+};
+
+} // namespace fiberize
+
+#endif // FIBERIZE_TOPOLOGY_HPP
@@ -16,13 +16,7 @@ Condition::Condition()
 void Condition::await(std::unique_lock<Spinlock>& lock) {
     assert(lock.owns_lock());
 
-    // Append ourself to the queue.
-    queue.push_back(context::detail::task());
-
-    // Important: grab the ticket AFTER appending to the queue, to ensure that
-    //            the ticket number is consistent if the queue throws an exception.
-    uint64_t ticket = nextTicket++;
-
+    uint64_t ticket = subscribe(lock);
     lock.unlock();
 
     try {
@@ -47,13 +41,7 @@ void Condition::await(std::unique_lock<Spinlock>& lock) {
     } catch (...) {
         // Something (probably a handler) threw an exception. Ensure that we don't eat the signal.
         lock.lock();
-        uint64_t rel = released.load(std::memory_order_relaxed);
-        if (rel < ticket) {
-            // Set our task to nullptr to signal that we don't want the lock anymore.
-            // We can calculate our index in the queue using the released and ticket numbers.
-            uint64_t queueIndex = ticket - rel - 1;
-            queue[size_t(queueIndex)] = nullptr;
-        } else {
+        if (!unsubscribe(ticket, lock)) {
             // We already got signaled. Forward that signal to some other task.
             signal(lock);
         }
@@ -66,6 +54,33 @@ void Condition::await(std::unique_lock<Spinlock>& lock) {
     lock.lock();
 }
 
+uint64_t Condition::subscribe(std::unique_lock<Spinlock>& lock) {
+    assert(lock.owns_lock());
+    (void) lock;
+
+    // Append ourself to the queue.
+    queue.push_back(context::detail::task());
+
+    // Important: grab the ticket AFTER appending to the queue, to ensure that
+    //            the ticket number is consistent if the queue throws an exception.
+    return nextTicket++;
+}
+
+bool Condition::unsubscribe(uint64_t ticket, std::unique_lock<Spinlock>& lock) {
+    assert(lock.owns_lock());
+    (void) lock;
+
+    uint64_t rel = released.load(std::memory_order_relaxed);
+    if (rel >= ticket)
+        return false;
+
+    // Set our task to nullptr to signal that we don't want the lock anymore.
+    // We can calculate our index in the queue using the released and ticket numbers.
+    uint64_t queueIndex = ticket - rel - 1;
+    queue[size_t(queueIndex)] = nullptr;
+    return true;
+}
+
 void Condition::signal(std::unique_lock<Spinlock>& lock) {
     assert(lock.owns_lock());
 
@@ -91,9 +91,11 @@ void processUntil(const bool& condition) {
                 return;
             }
 
+            checkpoint();
             lock.lock();
         }
         task->resumesExpected = task->resumes;
+        task->deadline.store(task->baseDeadline, std::memory_order_relaxed);
         lock.unlock();
 
         /**
@@ -127,9 +129,23 @@ void process(std::unique_lock<Spinlock>& lock) {
         }
         if (event.freeData)
             event.freeData(event.data);
+        checkpoint();
         lock.lock();
     }
     task->resumesExpected = task->resumes;
+    task->deadline.store(task->baseDeadline, std::memory_order_relaxed);
+}
+
+void advance(std::unique_lock<Spinlock>& lock) {
+    auto task = detail::task();
+    if (task->coroutine) {
+        // The coroutine processes the events itself, before it decides whether to continue.
+        lock.unlock();
+        task->runnable->run();
+        lock.lock();
+    } else {
+        process(lock);
+    }
 }
 
 fiberize::detail::Task* task() {
@@ -199,37 +215,70 @@ void resume(fiberize::detail::Task* task) {
     resume(task, std::unique_lock<Spinlock>(task->spinlock));
 }
 
-void resume(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock) {
-    assert(lock.owns_lock());
-    task->resumes += 1;
+/**
+ * Whether a task can be resumed. Scheduled and running tasks cannot.
+ */
+static bool resumable(fiberize::detail::Task* task) {
+    return (task->status == fiberize::detail::Suspended
+        || task->status == fiberize::detail::Starting
+        || task->status == fiberize::detail::Listening) && !task->scheduled;
+}
+
+/**
+ * Picks a random multitasking scheduler.
+ */
+static Scheduler* randomScheduler(fiberize::detail::Task* task) {
+    const auto& schedulers = system()->schedulersIn(task->pool);
+    std::uniform_int_distribution<size_t> dist(0, schedulers.size() - 1);
+    return schedulers[dist(scheduler()->random())];
+}
 
+/**
+ * Whether a resumed task should go back to the scheduler that ran it last time.
+ */
+static bool wakeOnLast(fiberize::detail::Task* task) {
+    if (task->lastScheduler == nullptr || system()->config().wakePolicy != WakePolicy::Last)
+        return false;
+
+    auto last = static_cast<fiberize::detail::MultiTaskScheduler*>(task->lastScheduler);
+    return !last->isRetired() && last->load() < system()->config().wakeLoadLimit;
+}
+
+/**
+ * Passes a resumable task to a scheduler.
+ */
+static void dispatch(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock) {
     Scheduler* sched;
     bool knownMultiTasking = false;
 
-    /**
-     * Do not resume a scheduled or running task.
-     */
-    if ((task->status != fiberize::detail::Suspended
-        && task->status != fiberize::detail::Starting
-        && task->status != fiberize::detail::Listening) || task->scheduled)
-        return;
-
     if (task->pin != nullptr) {
         /**
          * Forward pinned tasks to their scheduler.
          */
         sched = task->pin;
+    } else if (task->preferred != nullptr && task->preferred->isMultiTasking()
+        && !static_cast<fiberize::detail::MultiTaskScheduler*>(task->preferred)->isRetired()) {
+        /**
+         * Send the task back to the scheduler it prefers, which will share it with thieves if it is busy.
+         */
+        sched = task->preferred;
+        knownMultiTasking = true;
+    } else if (wakeOnLast(task)) {
+        /**
+         * Return the task to the caches it warmed up.
+         */
+        sched = task->lastScheduler;
+        knownMultiTasking = true;
     } else {
         /**
-         * If the current scheduler is a multi tasking one, use it. Otherwise pick a random
-         * multitasking scheduler.
+         * If the current scheduler is a multi tasking one in the task's pool, use it. Otherwise
+         * pick a random multitasking scheduler of the pool.
          */
-        if (scheduler()->isMultiTasking()) {
+        if (scheduler()->isMultiTasking() && system()->config().wakePolicy != WakePolicy::Random
+            && static_cast<fiberize::detail::MultiTaskScheduler*>(scheduler())->pool() == task->pool) {
             sched = scheduler();
         } else {
-            std::uniform_int_distribution<size_t> dist(0, system()->schedulers().size() - 1);
-            size_t index = dist(scheduler()->random());
-            sched = system()->schedulers()[index];
+            sched = randomScheduler(task);
         }
         knownMultiTasking = true;
     }
@@ -241,6 +290,90 @@ void resume(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock) {
     }
 }
 
+void resume(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock) {
+    assert(lock.owns_lock());
+    task->resumes += 1;
+
+    /**
+     * Do not resume a scheduled or running task.
+     */
+    if (!resumable(task))
+        return;
+
+    dispatch(task, std::move(lock));
+}
+
+void resumeAndSwitch(fiberize::detail::Task* task, std::unique_lock<Spinlock> lock) {
+    assert(lock.owns_lock());
+    task->resumes += 1;
+
+    if (!resumable(task))
+        return;
+
+    /**
+     * Only a suspended task has a context we can jump to. It must be allowed to run here
+     * and we must be running a task on a multitasking scheduler.
+     */
+    Scheduler* sched = scheduler();
+    if (task->status == fiberize::detail::Suspended
+        && (task->pin == nullptr || task->pin == sched)
+        && sched->isMultiTasking()
+        && (task->pin != nullptr || static_cast<fiberize::detail::MultiTaskScheduler*>(sched)->pool() == task->pool)) {
+        static_cast<fiberize::detail::MultiTaskScheduler*>(sched)->switchTo(task, std::move(lock));
+    } else {
+        dispatch(task, std::move(lock));
+    }
+}
+
+void resumeWithDeadline(fiberize::detail::Task* task, uint64_t deadline, std::unique_lock<Spinlock> lock) {
+    assert(lock.owns_lock());
+    if (!task->tightenDeadline(deadline) || !task->scheduled) {
+        resume(task, std::move(lock));
+        return;
+    }
+
+    /**
+     * The task already waits in a queue ordered by its old deadline or its priority. Queue a copy
+     * by the new deadline, whichever copy is taken first runs the task.
+     */
+    Scheduler* sched = task->pin;
+    if (sched == nullptr) {
+        if (scheduler()->isMultiTasking()
+            && static_cast<fiberize::detail::MultiTaskScheduler*>(scheduler())->pool() == task->pool) {
+            sched = scheduler();
+        } else {
+            sched = randomScheduler(task);
+        }
+    }
+
+    task->resumes += 1;
+    if (sched->isMultiTasking()) {
+        static_cast<fiberize::detail::MultiTaskScheduler*>(sched)->escalate(task, std::move(lock));
+    }
+}
+
+thread_local std::atomic<bool> preemptRequested(false);
+
+void preempt() {
+    preemptRequested.store(false, std::memory_order_relaxed);
+
+    Scheduler* sched = scheduler();
+    if (sched != nullptr && sched->isMultiTasking())
+        static_cast<fiberize::detail::MultiTaskScheduler*>(sched)->preempt();
+}
+
+bool enterBlocking() {
+    Scheduler* sched = Scheduler::current();
+    if (sched == nullptr || !sched->isMultiTasking())
+        return false;
+
+    return static_cast<fiberize::detail::MultiTaskScheduler*>(sched)->enterBlocking();
+}
+
+void leaveBlocking() {
+    fiberize::detail::MultiTaskScheduler::leaveBlocking();
+}
+
 } // namespace detail
 
 } // namespace context
@@ -0,0 +1,185 @@
+/**
+ * Saved execution contexts and switching between them.
+ *
+ * @file context.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/context.hpp>
+
+#ifdef FIBERIZE_INTREE_CONTEXT
+
+#include <cstring>
+
+/**
+ * Entered by the first jump to a new context, with the function in a callee-saved register
+ * and its argument already in the first argument register. Traps if the function returns.
+ */
+extern "C" void fiberize_start_context();
+
+#if defined(__x86_64__)
+
+/**
+ * Frame saved on the stack of a suspended context, from the saved stack pointer up:
+ * MXCSR, x87 control word, r12, r13, r14, r15, rbx, rbp and the return address.
+ */
+asm(R"(
+    .pushsection .text
+    .globl fiberize_jump_context
+    .type fiberize_jump_context, @function
+    .align 16
+fiberize_jump_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    leaq -0x8(%rsp), %rsp
+    stmxcsr (%rsp)
+    fnstcw 0x4(%rsp)
+    movq %rsp, (%rdi)
+
+    movq %rsi, %rsp
+    testl %ecx, %ecx
+    je 1f
+    ldmxcsr (%rsp)
+    fldcw 0x4(%rsp)
+1:
+    leaq 0x8(%rsp), %rsp
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+    popq %rbx
+    popq %rbp
+    popq %r8
+    movq %rdx, %rax
+    movq %rdx, %rdi
+    jmp *%r8
+    .size fiberize_jump_context, .-fiberize_jump_context
+
+    .globl fiberize_start_context
+    .type fiberize_start_context, @function
+    .align 16
+fiberize_start_context:
+    callq *%r12
+    ud2
+    .size fiberize_start_context, .-fiberize_start_context
+    .popsection
+)");
+
+namespace {
+
+struct Frame {
+    uint32_t mxcsr;
+    uint16_t fpuControl;
+    uint16_t padding;
+    uint64_t r12, r13, r14, r15, rbx, rbp;
+    uint64_t returnAddress;
+};
+
+} // namespace
+
+#elif defined(__aarch64__)
+
+/**
+ * Frame saved on the stack of a suspended context, from the saved stack pointer up:
+ * d8-d15, x19-x28, the frame pointer, the link register and FPCR.
+ */
+asm(R"(
+    .pushsection .text
+    .globl fiberize_jump_context
+    .type fiberize_jump_context, %function
+    .align 4
+fiberize_jump_context:
+    sub sp, sp, #0xb0
+    stp d8, d9, [sp, #0x00]
+    stp d10, d11, [sp, #0x10]
+    stp d12, d13, [sp, #0x20]
+    stp d14, d15, [sp, #0x30]
+    stp x19, x20, [sp, #0x40]
+    stp x21, x22, [sp, #0x50]
+    stp x23, x24, [sp, #0x60]
+    stp x25, x26, [sp, #0x70]
+    stp x27, x28, [sp, #0x80]
+    stp x29, x30, [sp, #0x90]
+    mrs x9, fpcr
+    str x9, [sp, #0xa0]
+    mov x9, sp
+    str x9, [x0]
+
+    mov sp, x1
+    cbz w3, 1f
+    ldr x9, [sp, #0xa0]
+    msr fpcr, x9
+1:
+    ldp d8, d9, [sp, #0x00]
+    ldp d10, d11, [sp, #0x10]
+    ldp d12, d13, [sp, #0x20]
+    ldp d14, d15, [sp, #0x30]
+    ldp x19, x20, [sp, #0x40]
+    ldp x21, x22, [sp, #0x50]
+    ldp x23, x24, [sp, #0x60]
+    ldp x25, x26, [sp, #0x70]
+    ldp x27, x28, [sp, #0x80]
+    ldp x29, x30, [sp, #0x90]
+    add sp, sp, #0xb0
+    mov x0, x2
+    ret
+    .size fiberize_jump_context, .-fiberize_jump_context
+
+    .globl fiberize_start_context
+    .type fiberize_start_context, %function
+    .align 4
+fiberize_start_context:
+    blr x19
+    brk #0
+    .size fiberize_start_context, .-fiberize_start_context
+    .popsection
+)");
+
+namespace {
+
+struct Frame {
+    uint64_t d[8];
+    uint64_t x19, x20, x21, x22, x23, x24, x25, x26, x27, x28;
+    uint64_t fp, lr;
+    uint64_t fpcr;
+    uint64_t padding;
+};
+
+} // namespace
+
+#endif
+
+namespace fiberize {
+namespace detail {
+
+Context makeContext(void* sp, size_t size, void (*fn)(intptr_t)) {
+    (void) size;
+
+    // The stack pointer is aligned to 16 bytes on the entry to the trampoline. The new context starts
+    // with the floating point control registers of the creating thread, loading a different value
+    // stalls the pipeline on every switch.
+    uintptr_t top = reinterpret_cast<uintptr_t>(sp) & ~uintptr_t(15);
+    Frame* frame = reinterpret_cast<Frame*>(top - sizeof(Frame));
+    std::memset(frame, 0, sizeof(Frame));
+
+#if defined(__x86_64__)
+    asm volatile ("stmxcsr %0" : "=m" (frame->mxcsr));
+    asm volatile ("fnstcw %0" : "=m" (frame->fpuControl));
+    frame->r12 = reinterpret_cast<uint64_t>(fn);
+    frame->returnAddress = reinterpret_cast<uint64_t>(&fiberize_start_context);
+#elif defined(__aarch64__)
+    asm volatile ("mrs %0, fpcr" : "=r" (frame->fpcr));
+    frame->x19 = reinterpret_cast<uint64_t>(fn);
+    frame->lr = reinterpret_cast<uint64_t>(&fiberize_start_context);
+#endif
+
+    return frame;
+}
+
+} // namespace detail
+} // namespace fiberize
+
+#endif // FIBERIZE_INTREE_CONTEXT
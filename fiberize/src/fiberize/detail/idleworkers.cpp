@@ -0,0 +1,106 @@
+/**
+ * Bookkeeping of spinning and parked macrothreads.
+ *
+ * @file idleworkers.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/idleworkers.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <algorithm>
+#include <mutex>
+
+namespace fiberize {
+namespace detail {
+
+IdleWorkers::IdleWorkers(uint32_t workers)
+    : workers(workers), spinning_(0), parkedCount(0) {}
+
+void IdleWorkers::setWorkers(uint32_t workers) {
+    this->workers.store(workers, std::memory_order_relaxed);
+}
+
+bool IdleWorkers::startSpinning(bool force) {
+    // The check is racy, a few extra spinners are harmless.
+    uint32_t workers = this->workers.load(std::memory_order_relaxed);
+    uint32_t active = workers - std::min(workers, parkedCount.load(std::memory_order_relaxed));
+    if (!force && 2 * spinning_.load(std::memory_order_relaxed) >= std::max(active, 2u))
+        return false;
+
+    spinning_.fetch_add(1, std::memory_order_seq_cst);
+    return true;
+}
+
+void IdleWorkers::stopSpinning(bool foundWork) {
+    if (spinning_.fetch_sub(1, std::memory_order_seq_cst) == 1 && foundWork)
+        wakeOne();
+}
+
+void IdleWorkers::wakeOne() {
+    // Pairs with the fence in MultiTaskScheduler::park.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parkedCount.load(std::memory_order_relaxed) == 0 || spinning_.load(std::memory_order_relaxed) != 0)
+        return;
+
+    // Only one waker at a time, the woken scheduler takes over the spinning slot.
+    uint32_t expected = 0;
+    if (!spinning_.compare_exchange_strong(expected, 1, std::memory_order_seq_cst))
+        return;
+
+    MultiTaskScheduler* scheduler = nullptr;
+    std::unique_lock<Spinlock> lock(spinlock);
+    if (!parked_.empty()) {
+        // The most recently parked scheduler has the warmest caches.
+        scheduler = parked_.back();
+        parked_.pop_back();
+        parkedCount.fetch_sub(1, std::memory_order_relaxed);
+        scheduler->wokenSpinning.store(true, std::memory_order_relaxed);
+        scheduler->parked.store(false, std::memory_order_release);
+    }
+    lock.unlock();
+
+    if (scheduler == nullptr) {
+        stopSpinning(false);
+        return;
+    }
+
+    scheduler->ioContext().wakeup();
+}
+
+void IdleWorkers::wake(MultiTaskScheduler* scheduler) {
+    // Pairs with the fence in MultiTaskScheduler::park.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!scheduler->parked.load(std::memory_order_relaxed))
+        return;
+
+    if (unpark(scheduler))
+        scheduler->ioContext().wakeup();
+}
+
+void IdleWorkers::park(MultiTaskScheduler* scheduler) {
+    std::lock_guard<Spinlock> lock(spinlock);
+    scheduler->parked.store(true, std::memory_order_relaxed);
+
+    // Retired schedulers can only be woken directly, they don't look for work.
+    if (!scheduler->retired.load(std::memory_order_relaxed)) {
+        parked_.push_back(scheduler);
+        parkedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool IdleWorkers::unpark(MultiTaskScheduler* scheduler) {
+    std::lock_guard<Spinlock> lock(spinlock);
+    if (!scheduler->parked.load(std::memory_order_relaxed))
+        return false;
+
+    auto it = std::find(parked_.begin(), parked_.end(), scheduler);
+    if (it != parked_.end()) {
+        parked_.erase(it);
+        parkedCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    scheduler->parked.store(false, std::memory_order_release);
+    return true;
+}
+
+} // namespace detail
+} // namespace fiberize
@@ -26,9 +26,21 @@ Path LocalFiberRef::path() const {
 }
 
 void LocalFiberRef::send(const PendingEvent& pendingEvent) {
+    context::detail::resume(task, enqueue(pendingEvent));
+}
+
+void LocalFiberRef::sendAndSwitch(const PendingEvent& pendingEvent) {
+    context::detail::resumeAndSwitch(task, enqueue(pendingEvent));
+}
+
+void LocalFiberRef::sendWithDeadline(const PendingEvent& pendingEvent, uint64_t deadline) {
+    context::detail::resumeWithDeadline(task, deadline, enqueue(pendingEvent));
+}
+
+std::unique_lock<Spinlock> LocalFiberRef::enqueue(const PendingEvent& pendingEvent) {
     std::unique_lock<Spinlock> lock(task->spinlock);
     task->mailbox->enqueue(pendingEvent);
-    context::detail::resume(task, std::move(lock));
+    return lock;
 }
 
 } // namespace detail
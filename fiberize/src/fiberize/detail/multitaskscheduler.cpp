@@ -6,74 +6,471 @@
  */
 #include <fiberize/detail/multitaskscheduler.hpp>
 #include <fiberize/fibersystem.hpp>
+#include <fiberize/detail/idleworkers.hpp>
+#include <fiberize/detail/schedulerpool.hpp>
+#include <fiberize/detail/schedulerthreads.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+#include <pthread.h>
 
 namespace fiberize {
 namespace detail {
 
 constexpr uint64_t sameStreakLimit = 64;
-constexpr uint64_t stashSize = 256;
+constexpr uint64_t stashBytes = 8 * 1024 * 1024;
 constexpr uint64_t stealTries = 2;
+constexpr uint64_t remoteCapacity = 128;
+constexpr size_t inboxBatch = 64;
+constexpr size_t stealBatchLimit = 64;
+constexpr uint64_t spinLimit = 64;
+constexpr uint64_t inlineLimit = 64;
+constexpr uint64_t runNextStreakLimit = 32;
+constexpr uint64_t runNextStealDelay = 20 * 1000;
+
+/**
+ * A waiting priority class goes first after this many tasks of higher classes ran in a row.
+ */
+constexpr uint64_t agingLimits[priorityClasses] = {0, 16, 64};
+
+static inline size_t levelOf(Task* task) {
+    return static_cast<size_t>(task->priority);
+}
+
+constexpr size_t criticalLevel = static_cast<size_t>(Priority::Critical);
+constexpr size_t normalLevel = static_cast<size_t>(Priority::Normal);
+
+/**
+ * Orders the deadline heaps, the earliest deadline on top.
+ */
+static inline bool laterDeadline(const std::pair<uint64_t, Task*>& a, const std::pair<uint64_t, Task*>& b) {
+    return a.first > b.first;
+}
+
+/**
+ * The task blocking the current thread, with the scheduler it was running on and the context
+ * this thread runs the scheduler from.
+ */
+struct BlockedTask {
+    Task* task;
+    MultiTaskScheduler* scheduler;
+    Context home;
+    uint64_t call;
+};
+
+static thread_local BlockedTask blocked = {nullptr, nullptr, nullptr, 0};
+
+/**
+ * Whether a switch to or from the given task has to restore the floating point control registers.
+ * Contexts running the scheduler loops never change them, the thread a scheduler runs on gets its
+ * own back when the scheduler returns to it.
+ */
+static inline bool restoresFpu(const Task* task) {
+    return !task->integerOnly;
+}
+
+/**
+ * Whether the given task can process its events on the rest of the stack we are running on.
+ */
+static bool processesInline(const Task* task, const boost::context::stack_context& stack) {
+    if (!(task->nonBlockingHandlers || task->coroutine) || task->status != Listening)
+        return false;
 
-MultiTaskScheduler::MultiTaskScheduler(FiberSystem* system, uint64_t seed)
+#ifdef FIBERIZE_SEGMENTED_STACKS
+    (void) stack;
+    return true;
+#else
+    uintptr_t bottom = reinterpret_cast<uintptr_t>(stack.sp) - stack.size;
+    uintptr_t here = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    return here - bottom >= StackPool::classSize(StackPool::sizeClass(task->stackSize)) / 2;
+#endif
+}
+
+/**
+ * Aborts if a task running inline on a borrowed stack tries to suspend. Switching away from it would
+ * leave the scheduler frames below the task on a stack that someone else resumes.
+ */
+static void checkNotInline(const Task* inlineTask) {
+    if (inlineTask != nullptr) {
+        std::cerr << "fiberize: task " << toString(inlineTask->path)
+            << " suspended in a non-blocking handler or a coroutine" << std::endl;
+        std::abort();
+    }
+}
+
+MultiTaskScheduler::MultiTaskScheduler(FiberSystem* system, uint32_t index, uint64_t seed)
     : Scheduler(system, seed)
     , stopping(false)
+    , retired(false)
+    , running(false)
+    , blockingCall(0)
+    , blockingSince(0)
+    , handoff(system->config().blockingHandoff)
+    , handoffDelay(std::chrono::duration_cast<std::chrono::nanoseconds>(system->config().blockingHandoffDelay).count())
+    , sliceStart(0)
+    , timeSlice(std::chrono::duration_cast<std::chrono::nanoseconds>(system->config().timeSlice).count())
+    , overrunThreshold(std::chrono::duration_cast<std::chrono::nanoseconds>(system->config().overrunThreshold).count())
+    , preemptFlag(nullptr)
+    , spinning(false)
+    , parked(false)
+    , wokenSpinning(false)
+    , victims(nullptr)
+    , pool_(nullptr)
+    , stealHalf(system->config().stealHalf)
+    , sharded(system->config().sharded)
+    , preferredStealDelay(std::chrono::duration_cast<std::chrono::nanoseconds>(system->config().preferredStealDelay).count())
+    , preferredStealDepth(system->config().preferredStealDepth)
+    , deadlineCount(0)
+    , remoteTasks(remoteCapacity)
+    , remotePinnedTasks(remoteCapacity)
+    , remoteCount(0)
+    , inboxes(nullptr)
+    , index_(index)
+    , runNext(nullptr)
+    , runNextTime(0)
+    , runNextStreak(0)
     , sameStreak(0)
     , suspendingTask(nullptr)
     , currentTask_(nullptr)
-    , unowned(nullptr) {
-    stash.reserve(stashSize);
+    , unowned(nullptr)
+    , takenStatus(Dead)
+    , inlineTask(nullptr)
+    , replacedUnowned(nullptr)
+    , stackPool(system->stackPool())
+    , stackProfile(system->config().stackProfiling ? &system->stackProfile() : nullptr) {
+    std::fill(std::begin(skipped), std::end(skipped), 0);
 }
 
 MultiTaskScheduler::~MultiTaskScheduler() {
     if (!stopping.load(std::memory_order_consume))
         stop();
+
+    Inbox* inbox = inboxes.load(std::memory_order_acquire);
+    while (inbox != nullptr) {
+        Inbox* next = inbox->next;
+        delete inbox;
+        inbox = next;
+    }
+}
+
+void MultiTaskScheduler::setCpu(const Cpu& cpu) {
+    cpu_ = cpu;
+}
+
+void MultiTaskScheduler::setPool(SchedulerPool* pool) {
+    pool_ = pool;
+}
+
+const std::vector<MultiTaskScheduler*>& MultiTaskScheduler::peers() {
+    return pool_ != nullptr ? pool_->schedulers : system()->schedulers();
+}
+
+IdleWorkers& MultiTaskScheduler::idleWorkers() {
+    return pool_ != nullptr ? *pool_->idleWorkers : system()->idleWorkers();
+}
+
+void MultiTaskScheduler::setVictims(const Victims* victims) {
+    this->victims.store(victims, std::memory_order_release);
 }
 
 void MultiTaskScheduler::start() {
-    thread = std::thread([this] () {
-        makeCurrent();
-        unowned = stashGet();
-        boost::context::jump_fcontext(&initialContext, unowned->context, 0);
-        if (unowned != nullptr) {
-            stashPut(unowned);
-            unowned = nullptr;
-        }
-        resetCurrent();
-    });
+    running = true;
+    system()->schedulerThreads().run(this);
+}
+
+void MultiTaskScheduler::run() {
+    if (cpu_ && cpu_->id < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_->id, &set);
+        // Pinning is only an optimization, ignore failures.
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    threadHandle.store(pthread_self(), std::memory_order_relaxed);
+    preemptFlag.store(&context::detail::preemptRequested, std::memory_order_release);
+
+    makeCurrent();
+    unowned = stashGet(StackPool::sizeClass(0));
+    jumpContext(&initialContext, unowned->context, 0, true);
+    resetCurrent();
+
+    if (blocked.task != nullptr) {
+        // We come back from a blocking call and the scheduler runs on another thread now. The context
+        // of the task is saved, reschedule it like finishSuspending() does.
+        Task* task = blocked.task;
+        blocked.task = nullptr;
+        blocked.scheduler = nullptr;
+
+        std::unique_lock<Spinlock> lock(task->spinlock);
+        assert(task->status == Running);
+        task->status = Suspended;
+        task->scheduled = false;
+        resume(task, std::move(lock));
+        return;
+    }
+
+    if (unowned != nullptr) {
+        stashPut(unowned);
+        unowned = nullptr;
+    }
+
+    // Notify while holding the lock, the scheduler can be destroyed as soon as stop() returns.
+    std::lock_guard<std::mutex> lock(runningMutex);
+    running = false;
+    runningCondition.notify_all();
 }
 
 void MultiTaskScheduler::stop() {
     stopping.store(true, std::memory_order_release);
-    thread.join();
+    ioContext().wakeup();
+
+    std::unique_lock<std::mutex> lock(runningMutex);
+    runningCondition.wait(lock, [this] () { return !running; });
+    lock.unlock();
+
     stashClear();
 }
 
+void MultiTaskScheduler::retire() {
+    retired.store(true, std::memory_order_seq_cst);
+
+    // Wake up to hand over the queued tasks.
+    idleWorkers().wake(this);
+}
+
+void MultiTaskScheduler::reactivate() {
+    retired.store(false, std::memory_order_seq_cst);
+
+    // A retired scheduler parks where wakeOne() can't find it.
+    idleWorkers().wake(this);
+}
+
+void MultiTaskScheduler::requestPreemption(uint64_t now, int signal) {
+    std::atomic<bool>* flag = preemptFlag.load(std::memory_order_acquire);
+    uint64_t start = sliceStart.load(std::memory_order_relaxed);
+    if (flag == nullptr || start == 0 || now < start || now - start < timeSlice)
+        return;
+
+    if (signal != 0) {
+        pthread_kill(threadHandle.load(std::memory_order_relaxed), signal);
+    } else {
+        flag->store(true, std::memory_order_relaxed);
+    }
+}
+
+void MultiTaskScheduler::preempt() {
+    // Only preempt task code, never the scheduler itself or IO callbacks. Handlers running inline can't yield.
+    uint64_t start = sliceStart.load(std::memory_order_relaxed);
+    if (start == 0 || uv_hrtime_fast() - start < timeSlice || inlineTask != nullptr)
+        return;
+
+    yield();
+}
+
+void MultiTaskScheduler::requestHandoff(uint64_t now) {
+    uint64_t call = blockingCall.load(std::memory_order_acquire);
+    uint64_t since = blockingSince.load(std::memory_order_relaxed);
+    if (call % 2 == 0 || now < since || now - since < handoffDelay)
+        return;
+
+    // If we win, the blocked thread won't touch the scheduler again.
+    if (!blockingCall.compare_exchange_strong(call, call + 1, std::memory_order_acq_rel))
+        return;
+
+    currentTask_ = nullptr;
+    system()->schedulerThreads().run(this);
+}
+
+bool MultiTaskScheduler::busy() const {
+    return sliceStart.load(std::memory_order_relaxed) != 0
+        || blockingCall.load(std::memory_order_relaxed) % 2 == 1;
+}
+
+bool MultiTaskScheduler::enterBlocking() {
+    if (!handoff || currentTask_ == nullptr || inlineTask != nullptr)
+        return false;
+
+    endSlice();
+
+    blocked.task = currentTask_;
+    blocked.scheduler = this;
+    blocked.home = initialContext;
+    blocked.call = blockingCall.load(std::memory_order_relaxed) + 1;
+
+    // The scheduler may move to another thread, this one is no longer a scheduler thread.
+    resetCurrent();
+    blockingSince.store(uv_hrtime_fast(), std::memory_order_relaxed);
+    blockingCall.store(blocked.call, std::memory_order_release);
+    return true;
+}
+
+void MultiTaskScheduler::leaveBlocking() {
+    MultiTaskScheduler* self = blocked.scheduler;
+    uint64_t call = blocked.call;
+    if (self->blockingCall.compare_exchange_strong(call, call + 1, std::memory_order_acq_rel)) {
+        // Nobody took the scheduler, continue running on it.
+        blocked.task = nullptr;
+        blocked.scheduler = nullptr;
+        self->makeCurrent();
+        self->beginSlice();
+        return;
+    }
+
+    // The scheduler runs on another thread. Return to the context this thread ran it from,
+    // which reschedules the task once its context is saved.
+    Task* task = blocked.task;
+    task->resumesExpected = std::numeric_limits<uint64_t>::max();
+    jumpContext(&task->context, blocked.home, 0, true);
+
+    finishSwitching();
+}
+
+void MultiTaskScheduler::beginSlice() {
+    sliceStart.store(uv_hrtime_fast(), std::memory_order_relaxed);
+}
+
+void MultiTaskScheduler::endSlice() {
+    uint64_t start = sliceStart.load(std::memory_order_relaxed);
+    if (start == 0)
+        return;
+    sliceStart.store(0, std::memory_order_relaxed);
+
+    uint64_t time = uv_hrtime_fast() - start;
+    if (time > overrunThreshold && system()->config().overrunHandler)
+        system()->config().overrunHandler(currentTask_->path, std::chrono::nanoseconds(time));
+}
+
+size_t MultiTaskScheduler::load() const {
+    size_t load = deadlineCount.load(std::memory_order_relaxed);
+    load += runNext.load(std::memory_order_relaxed) != nullptr ? 1 : 0;
+    load += remoteCount.load(std::memory_order_relaxed);
+    for (Inbox* inbox = inboxes.load(std::memory_order_acquire); inbox != nullptr; inbox = inbox->next) {
+        load += inbox->tasks.size();
+    }
+    for (const Queues& level : queues) {
+        load += level.softTasks.size() + level.hardTasks.size();
+        load += level.preferredCount.load(std::memory_order_relaxed);
+    }
+    return load;
+}
+
 void MultiTaskScheduler::resume(Task* task, std::unique_lock<Spinlock> lock) {
     assert(lock.owns_lock());
     assert(task->status == Starting || task->status == Listening || task->status == Suspended);
     assert(!task->scheduled);
-    TaskStatus status = task->status;
+    bool pinned = task->pin != nullptr;
     task->resumes += 1;
     task->scheduled = true;
     lock.unlock();
 
-    if (status == Starting || status == Listening) {
-        std::unique_lock<Spinlock> lock(softMutex);
-        softTasks.push_front(task);
-    } else if (status == Suspended) {
-        std::unique_lock<Spinlock> lock(hardMutex);
-        hardTasks.push_front(task);
+    post(task, pinned);
+}
+
+void MultiTaskScheduler::post(Task* task, bool pinned) {
+    IdleWorkers& idleWorkers = this->idleWorkers();
+    if (Scheduler::current() == this && !pinned && retired.load(std::memory_order_relaxed)) {
+        // Retired schedulers only run pinned tasks, hand it over to an active one.
+        const auto& schedulers = peers();
+        std::uniform_int_distribution<size_t> dist(0, schedulers.size() - 1);
+        schedulers[dist(random())]->post(task, pinned);
+    } else if (Scheduler::current() == this) {
+        // We are the owner, push the task directly to the local queues. A task woken by another
+        // one runs next, but a task rescheduling itself goes to the back, so it can't starve others.
+        // Only normal tasks use the slot, the other classes have their own place in the order.
+        // Tasks preferring this scheduler wait in their own queue, guarded from thieves.
+        if (!pinned && task != currentTask_ && task != suspendingTask && task->priority == fiberize::Priority::Normal
+            && task->deadline.load(std::memory_order_relaxed) == 0 && task->preferred != this) {
+            enqueueNext(task);
+        } else {
+            enqueue(task);
+        }
+
+        // Let a parked scheduler steal it, unless someone is already looking for work.
+        if (!pinned)
+            idleWorkers.wakeOne();
+    } else if (pinned || (task->preferred == this && !busy())) {
+        // An idle scheduler collects the tasks preferring it right away, a busy one
+        // leaves them to the thieves. Nobody steals from a sharded system, so shards
+        // can use their inboxes even for pinned tasks.
+        Scheduler* producer = Scheduler::current();
+        if (!sharded || producer == nullptr || !producer->isMultiTasking()
+            || !static_cast<MultiTaskScheduler*>(producer)->pushInbox(this, task)) {
+            remoteCount.fetch_add(1, std::memory_order_relaxed);
+            while (!remotePinnedTasks.push(task)) {}
+        }
+
+        // Only we can run this task.
+        idleWorkers.wake(this);
     } else {
-        // Impossible.
-        __builtin_unreachable();
+        // Another scheduler uses its own inbox, everybody else and overflows go to the shared queue.
+        Scheduler* producer = Scheduler::current();
+        if (producer == nullptr || !producer->isMultiTasking()
+            || !static_cast<MultiTaskScheduler*>(producer)->pushInbox(this, task)) {
+            // Count the task first, so the counter never goes below zero.
+            remoteCount.fetch_add(1, std::memory_order_relaxed);
+            while (!remoteTasks.push(task)) {}
+        }
+
+        if (parked.load(std::memory_order_relaxed)) {
+            idleWorkers.wake(this);
+        } else {
+            idleWorkers.wakeOne();
+        }
     }
 }
 
+void MultiTaskScheduler::switchTo(Task* task, std::unique_lock<Spinlock> lock) {
+    assert(lock.owns_lock());
+    assert(task->status == Suspended);
+    assert(!task->scheduled);
+
+    // We can only switch away from a task that owns its stack and not while stopping or retired.
+    if (currentTask_ == nullptr || inlineTask != nullptr || stopping.load(std::memory_order_relaxed)
+        || retired.load(std::memory_order_relaxed)) {
+        resume(task, std::move(lock));
+        return;
+    }
+
+    // The task is never queued, claim it right away.
+    task->resumes += 1;
+    task->status = Running;
+    task->lastScheduler = this;
+    lock.unlock();
+
+    endSlice();
+
+    // The receiver finishes our suspension and puts us back to the queue, like yield() does.
+    currentTask_->resumesExpected = std::numeric_limits<uint64_t>::max();
+    suspendingTask = currentTask_;
+    currentTask_ = task;
+    sameStreak += 1;
+    jumpContext(&suspendingTask->context, currentTask_->context, 0,
+        restoresFpu(suspendingTask) || restoresFpu(currentTask_));
+
+    finishSwitching();
+}
+
+void MultiTaskScheduler::escalate(Task* task, std::unique_lock<Spinlock> lock) {
+    assert(lock.owns_lock());
+    assert(task->scheduled);
+    bool pinned = task->pin != nullptr;
+    task->refCount += 1;
+    lock.unlock();
+
+    post(task, pinned);
+}
+
 void MultiTaskScheduler::suspend() {
+    checkNotInline(inlineTask);
     ownedLoop();
 }
 
 void MultiTaskScheduler::yield() {
+    checkNotInline(inlineTask);
     currentTask_->resumesExpected = std::numeric_limits<uint64_t>::max();
     ownedLoop();
 }
@@ -86,70 +483,577 @@ bool MultiTaskScheduler::isMultiTasking() {
     return true;
 }
 
-void MultiTaskScheduler::dequeueSoft(Task*& task) {
-    std::unique_lock<Spinlock> lock(softMutex);
-    if (!softTasks.empty()) {
-        task = softTasks.front();
-        softTasks.pop_front();
+void MultiTaskScheduler::enqueue(Task* task) {
+    // Tasks with a deadline are ordered by it, no matter whether they are starting or suspended.
+    uint64_t deadline = task->deadline.load(std::memory_order_relaxed);
+    if (deadline != 0) {
+        if (task->pin == nullptr) {
+            std::lock_guard<Spinlock> lock(deadlineSpinlock);
+            deadlineTasks.emplace_back(deadline, task);
+            std::push_heap(deadlineTasks.begin(), deadlineTasks.end(), laterDeadline);
+            deadlineCount.store(deadlineTasks.size(), std::memory_order_relaxed);
+        } else {
+            pinnedDeadlineTasks.emplace_back(deadline, task);
+            std::push_heap(pinnedDeadlineTasks.begin(), pinnedDeadlineTasks.end(), laterDeadline);
+        }
+        return;
+    }
+
+    Queues& level = queues[levelOf(task)];
+
+    if (task->pin == nullptr && task->preferred == this) {
+        std::lock_guard<Spinlock> lock(level.preferredSpinlock);
+        level.preferredTasks.emplace_back(uv_hrtime_fast(), task);
+        level.preferredCount.store(level.preferredTasks.size(), std::memory_order_relaxed);
+        return;
     }
+
+    // Pinned tasks never enter the work stealing deques, so thieves don't have to look at them.
+    if (task->status == Starting || task->status == Listening) {
+        if (task->pin == nullptr) {
+            level.softTasks.push(task);
+        } else {
+            level.pinnedSoftTasks.push_front(task);
+        }
+    } else if (task->status == Suspended) {
+        if (task->pin == nullptr) {
+            level.hardTasks.push(task);
+        } else {
+            level.pinnedHardTasks.push_front(task);
+        }
+    } else {
+        // Impossible.
+        __builtin_unreachable();
+    }
+}
+
+void MultiTaskScheduler::enqueueNext(Task* task) {
+    runNextTime.store(uv_hrtime_fast(), std::memory_order_relaxed);
+    Task* previous = runNext.exchange(task, std::memory_order_acq_rel);
+
+    // Kick the previous task to the regular queue.
+    if (previous != nullptr)
+        enqueue(previous);
+}
+
+void MultiTaskScheduler::stealNext(Task*& task) {
+    Task* next = runNext.load(std::memory_order_relaxed);
+    if (next == nullptr)
+        return;
+
+    // The owner is probably about to run it, leave it alone unless it waits for too long.
+    if (uv_hrtime_fast() - runNextTime.load(std::memory_order_relaxed) < runNextStealDelay)
+        return;
+
+    if (runNext.compare_exchange_strong(next, nullptr, std::memory_order_acq_rel))
+        task = next;
 }
 
-void MultiTaskScheduler::stealSoft(Task*& task) {
-    std::unique_lock<Spinlock> lock(softMutex);
-    if (!softTasks.empty() && softTasks.back()->pin == nullptr) {
-        task = softTasks.back();
-        softTasks.pop_back();
+void MultiTaskScheduler::migrate() {
+    Task* task;
+    while (remoteTasks.pop(task)) {
+        remoteCount.fetch_sub(1, std::memory_order_relaxed);
+        post(task, false);
+    }
+    for (Queues& level : queues) {
+        while (level.softTasks.pop(task)) {
+            post(task, false);
+        }
+        while (level.hardTasks.pop(task)) {
+            post(task, false);
+        }
+        std::unique_lock<Spinlock> lock(level.preferredSpinlock);
+        while (!level.preferredTasks.empty()) {
+            task = level.preferredTasks.front().second;
+            level.preferredTasks.pop_front();
+            level.preferredCount.store(level.preferredTasks.size(), std::memory_order_relaxed);
+            lock.unlock();
+            post(task, false);
+            lock.lock();
+        }
+    }
+    task = runNext.exchange(nullptr, std::memory_order_acq_rel);
+    if (task != nullptr) {
+        post(task, false);
+    }
+    for (Inbox* inbox = inboxes.load(std::memory_order_acquire); inbox != nullptr; inbox = inbox->next) {
+        std::lock_guard<Spinlock> lock(inbox->consumer);
+        while (inbox->tasks.pop(task)) {
+            post(task, task->pin != nullptr);
+        }
+    }
+    for (;;) {
+        task = nullptr;
+        stealDeadline(task);
+        if (task == nullptr)
+            break;
+        post(task, false);
     }
 }
 
-void MultiTaskScheduler::dequeueHard(Task*& task) {
-    std::unique_lock<Spinlock> lock(hardMutex);
-    if (!hardTasks.empty()) {
-        task = hardTasks.front();
-        hardTasks.pop_front();
+void MultiTaskScheduler::drainRemote() {
+    Task* task;
+    while (remotePinnedTasks.pop(task)) {
+        remoteCount.fetch_sub(1, std::memory_order_relaxed);
+        enqueue(task);
+    }
+    while (remoteTasks.pop(task)) {
+        remoteCount.fetch_sub(1, std::memory_order_relaxed);
+        enqueue(task);
     }
+
+    // Take a batch from each inbox, unless a thief is already draining it.
+    for (Inbox* inbox = inboxes.load(std::memory_order_acquire); inbox != nullptr; inbox = inbox->next) {
+        if (inbox->tasks.empty() || !inbox->consumer.try_lock())
+            continue;
+        for (size_t i = 0; i < inboxBatch && inbox->tasks.pop(task); ++i) {
+            enqueue(task);
+        }
+        inbox->consumer.unlock();
+    }
+}
+
+bool MultiTaskScheduler::pushInbox(MultiTaskScheduler* target, Task* task) {
+    if (outboxes.size() <= target->index_)
+        outboxes.resize(target->index_ + 1, nullptr);
+
+    Inbox*& inbox = outboxes[target->index_];
+    if (inbox == nullptr)
+        inbox = target->addInbox();
+    return inbox->tasks.push(task);
 }
 
-void MultiTaskScheduler::stealHard(Task*& task) {
-    std::unique_lock<Spinlock> lock(hardMutex);
-    if (!hardTasks.empty() && hardTasks.back()->pin == nullptr) {
-        task = hardTasks.back();
-        hardTasks.pop_back();
+MultiTaskScheduler::Inbox* MultiTaskScheduler::addInbox() {
+    Inbox* inbox = new Inbox;
+    inbox->next = inboxes.load(std::memory_order_relaxed);
+    while (!inboxes.compare_exchange_weak(inbox->next, inbox, std::memory_order_release, std::memory_order_relaxed)) {}
+    return inbox;
+}
+
+void MultiTaskScheduler::dequeueSoft(Task*& task, size_t level) {
+    Queues& local = queues[level];
+    if (!local.pinnedSoftTasks.empty()) {
+        task = local.pinnedSoftTasks.front();
+        local.pinnedSoftTasks.pop_front();
+        return;
+    }
+
+    Task* popped;
+    if (local.softTasks.pop(popped)) {
+        task = popped;
+    }
+}
+
+void MultiTaskScheduler::stealSoft(Task*& task, MultiTaskScheduler* thief, size_t level) {
+    thief->stealFrom(queues[level].softTasks, task, thief->queues[level].softTasks);
+}
+
+void MultiTaskScheduler::dequeueHard(Task*& task, size_t level) {
+    Queues& local = queues[level];
+    if (!local.pinnedHardTasks.empty()) {
+        task = local.pinnedHardTasks.front();
+        local.pinnedHardTasks.pop_front();
+        return;
+    }
+
+    Task* popped;
+    if (local.hardTasks.pop(popped)) {
+        task = popped;
+    }
+}
+
+void MultiTaskScheduler::stealHard(Task*& task, MultiTaskScheduler* thief, size_t level) {
+    thief->stealFrom(queues[level].hardTasks, task, thief->queues[level].hardTasks);
+}
+
+void MultiTaskScheduler::stealFrom(WorkStealingDeque<Task*>& victim, Task*& task, WorkStealingDeque<Task*>& local) {
+    if (!stealHalf) {
+        Task* stolen;
+        if (victim.steal(stolen)) {
+            task = stolen;
+        }
+        return;
+    }
+
+    // Take up to half of the victim's tasks. Run the oldest one and keep the rest
+    // in our own deque, so we don't have to come back to the victim soon.
+    Task* stolen[stealBatchLimit];
+    size_t count = victim.stealHalf(stolen, stealBatchLimit);
+    if (count > 0) {
+        task = stolen[0];
+        for (size_t i = 1; i < count; ++i) {
+            local.push(stolen[i]);
+        }
+    }
+}
+
+void MultiTaskScheduler::dequeuePreferred(Task*& task, size_t level) {
+    Queues& local = queues[level];
+    if (local.preferredCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard<Spinlock> lock(local.preferredSpinlock);
+    if (local.preferredTasks.empty())
+        return;
+
+    task = local.preferredTasks.front().second;
+    local.preferredTasks.pop_front();
+    local.preferredCount.store(local.preferredTasks.size(), std::memory_order_relaxed);
+}
+
+void MultiTaskScheduler::stealPreferred(Task*& task, size_t level) {
+    Queues& local = queues[level];
+    if (local.preferredCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard<Spinlock> lock(local.preferredSpinlock);
+    if (local.preferredTasks.empty())
+        return;
+
+    // Leave the task to the owner, unless it waited too long or too many are waiting.
+    if (local.preferredTasks.size() <= preferredStealDepth
+        && uv_hrtime_fast() - local.preferredTasks.front().first < preferredStealDelay)
+        return;
+
+    task = local.preferredTasks.front().second;
+    local.preferredTasks.pop_front();
+    local.preferredCount.store(local.preferredTasks.size(), std::memory_order_relaxed);
+}
+
+void MultiTaskScheduler::dequeueDeadline(Task*& task) {
+    bool shared = deadlineCount.load(std::memory_order_relaxed) != 0;
+    if (pinnedDeadlineTasks.empty() && !shared)
+        return;
+
+    std::unique_lock<Spinlock> lock(deadlineSpinlock, std::defer_lock);
+    if (shared) {
+        lock.lock();
+        shared = !deadlineTasks.empty();
+    }
+
+    // Take the earlier of the two heads.
+    if (shared && (pinnedDeadlineTasks.empty() || deadlineTasks.front().first <= pinnedDeadlineTasks.front().first)) {
+        std::pop_heap(deadlineTasks.begin(), deadlineTasks.end(), laterDeadline);
+        task = deadlineTasks.back().second;
+        deadlineTasks.pop_back();
+        deadlineCount.store(deadlineTasks.size(), std::memory_order_relaxed);
+    } else if (!pinnedDeadlineTasks.empty()) {
+        std::pop_heap(pinnedDeadlineTasks.begin(), pinnedDeadlineTasks.end(), laterDeadline);
+        task = pinnedDeadlineTasks.back().second;
+        pinnedDeadlineTasks.pop_back();
+    }
+}
+
+void MultiTaskScheduler::stealDeadline(Task*& task) {
+    if (deadlineCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard<Spinlock> lock(deadlineSpinlock);
+    if (deadlineTasks.empty())
+        return;
+
+    std::pop_heap(deadlineTasks.begin(), deadlineTasks.end(), laterDeadline);
+    task = deadlineTasks.back().second;
+    deadlineTasks.pop_back();
+    deadlineCount.store(deadlineTasks.size(), std::memory_order_relaxed);
+}
+
+void MultiTaskScheduler::stealRemote(Task*& task) {
+    Task* stolen;
+    if (remoteTasks.pop(stolen)) {
+        remoteCount.fetch_sub(1, std::memory_order_relaxed);
+        task = stolen;
+        return;
+    }
+
+    for (Inbox* inbox = inboxes.load(std::memory_order_acquire); inbox != nullptr; inbox = inbox->next) {
+        if (inbox->tasks.empty() || !inbox->consumer.try_lock())
+            continue;
+        bool popped = inbox->tasks.pop(stolen);
+        inbox->consumer.unlock();
+        if (popped) {
+            task = stolen;
+            return;
+        }
     }
 }
 
 void MultiTaskScheduler::dequeue(Task*& task, MultiTaskScheduler::Priority priority) {
+    if (retired.load(std::memory_order_relaxed))
+        migrate();
+
+    drainRemote();
+
+    // Higher classes go first, unless a lower class has been waiting for too long.
+    size_t first = 0;
+    for (size_t level = priorityClasses - 1; level > 0; --level) {
+        if (skipped[level] >= agingLimits[level]) {
+            first = level;
+            break;
+        }
+    }
+
+    bool preferNext = runNextStreak < runNextStreakLimit;
+    for (size_t i = 0; i < priorityClasses; ++i) {
+        size_t level = (first + i) % priorityClasses;
+        dequeueLevel(task, level, priority, preferNext);
+        if (task) {
+            served(level);
+            return;
+        }
+
+        // Tasks with a deadline come right after the critical ones.
+        if (level == criticalLevel) {
+            dequeueDeadline(task);
+            if (task) {
+                served(criticalLevel);
+                return;
+            }
+        }
+    }
+
+    // Nothing else to do, so the next task doesn't have to wait anymore.
+    runNextStreak = 0;
+    task = runNext.exchange(nullptr, std::memory_order_acq_rel);
+    if (task)
+        served(normalLevel);
+}
+
+void MultiTaskScheduler::take(Task*& task, MultiTaskScheduler::Priority priority) {
+    for (;;) {
+        dequeue(task, priority);
+        if (task == nullptr)
+            steal(task, priority);
+        if (task == nullptr)
+            return;
+
+        takenStatus = task->status;
+        if (takenStatus == Starting || takenStatus == Listening)
+            return;
+
+        // We jump straight into the context of a suspended task, claim it first.
+        std::unique_lock<Spinlock> lock(task->spinlock);
+        if (takenStatus == Suspended && task->status == Suspended && task->scheduled) {
+            task->status = Running;
+            task->scheduled = false;
+            task->lastScheduler = this;
+            return;
+        }
+
+        discard(task, std::move(lock));
+        task = nullptr;
+    }
+}
+
+void MultiTaskScheduler::discard(Task* task, std::unique_lock<Spinlock> lock) {
+    if (task->scheduled) {
+        // The task changed since the copy was queued, look at it again later.
+        lock.unlock();
+        enqueue(task);
+    } else {
+        // Another copy already ran the task.
+        lock.unlock();
+        task->drop();
+    }
+}
+
+void MultiTaskScheduler::dequeueLevel(Task*& task, size_t level, MultiTaskScheduler::Priority priority, bool preferNext) {
+    // Run the most recently woken task first, unless it keeps other tasks waiting.
+    if (level == normalLevel) {
+        if (preferNext) {
+            task = runNext.exchange(nullptr, std::memory_order_acq_rel);
+            if (task) {
+                runNextStreak += 1;
+                return;
+            }
+        }
+        runNextStreak = 0;
+    }
+
+    dequeuePreferred(task, level);
+    if (task) return;
+
     if (priority == Soft) {
         for (int i = 0; i < 2; ++i) {
-            dequeueSoft(task); if (task) return;
-            dequeueHard(task); if (task) return;
+            dequeueSoft(task, level); if (task) return;
+            dequeueHard(task, level); if (task) return;
         }
     } else {
         for (int i = 0; i < 2; ++i) {
-            dequeueHard(task); if (task) return;
-            dequeueSoft(task); if (task) return;
+            dequeueHard(task, level); if (task) return;
+            dequeueSoft(task, level); if (task) return;
         }
     }
 }
 
+bool MultiTaskScheduler::waiting(size_t level) {
+    const Queues& local = queues[level];
+    if (level == normalLevel && runNext.load(std::memory_order_relaxed) != nullptr)
+        return true;
+    return !local.softTasks.empty() || !local.hardTasks.empty()
+        || !local.pinnedSoftTasks.empty() || !local.pinnedHardTasks.empty()
+        || local.preferredCount.load(std::memory_order_relaxed) != 0;
+}
+
+void MultiTaskScheduler::served(size_t level) {
+    skipped[level] = 0;
+    for (size_t lower = level + 1; lower < priorityClasses; ++lower) {
+        if (waiting(lower))
+            skipped[lower] += 1;
+    }
+}
+
 void MultiTaskScheduler::steal(Task*& task, MultiTaskScheduler::Priority priority) {
-    size_t n = system()->schedulers().size();
-    std::uniform_int_distribution<size_t> dist(0, n-1);
+    if (sharded || retired.load(std::memory_order_relaxed))
+        return;
+
+    // Don't join the thieves if enough schedulers are already looking for work.
+    if (!spinning) {
+        if (!idleWorkers().startSpinning())
+            return;
+        spinning = true;
+    }
+
+    const Victims* tiers = victims.load(std::memory_order_acquire);
+    if (tiers != nullptr && !tiers->empty()) {
+        // Visit the closest schedulers first, so tasks stay near the caches that touched them.
+        // Within a tier start at a random victim to spread the thieves.
+        for (const auto& tier : *tiers) {
+            std::uniform_int_distribution<size_t> dist(0, tier.size() - 1);
+            size_t offset = dist(random());
+            for (size_t i = 0; i < tier.size(); ++i) {
+                stealFrom(tier[(offset + i) % tier.size()], task, priority);
+                if (task) return;
+            }
+        }
+        return;
+    }
+
+    const auto& schedulers = peers();
+    std::uniform_int_distribution<size_t> dist(0, schedulers.size() - 1);
 
     for (uint i = 0; i < stealTries; ++i) {
         size_t index = dist(random());
-        auto target = system()->schedulers()[index];
+        auto target = schedulers[index];
+        if (target == this)
+            continue;
 
+        stealFrom(target, task, priority);
+        if (task) return;
+    }
+}
+
+void MultiTaskScheduler::stealFrom(MultiTaskScheduler* target, Task*& task, MultiTaskScheduler::Priority priority) {
+    // Thieves don't know how long the victim's tasks waited, they simply take the highest class.
+    for (size_t level = 0; level < priorityClasses; ++level) {
         if (priority == Soft) {
-            target->stealSoft(task); if (task) return;
-            target->stealHard(task); if (task) return;
+            target->stealSoft(task, this, level); if (task) return;
+            target->stealHard(task, this, level); if (task) return;
         } else {
-            target->stealHard(task); if (task) return;
-            target->stealSoft(task); if (task) return;
+            target->stealHard(task, this, level); if (task) return;
+            target->stealSoft(task, this, level); if (task) return;
+        }
+        target->stealPreferred(task, level); if (task) return;
+
+        if (level == criticalLevel) {
+            target->stealDeadline(task); if (task) return;
+        }
+    }
+
+    // The owner might be busy, take a task it didn't collect yet.
+    target->stealRemote(task); if (task) return;
+    target->stealNext(task);
+}
+
+void MultiTaskScheduler::stopSpinning() {
+    if (spinning) {
+        spinning = false;
+        idleWorkers().stopSpinning(true);
+    }
+}
+
+void MultiTaskScheduler::park() {
+    IdleWorkers& idleWorkers = this->idleWorkers();
+    if (spinning) {
+        spinning = false;
+        idleWorkers.stopSpinning(false);
+    }
+
+    idleWorkers.park(this);
+    for (;;) {
+        // Either we see the new work, or the waker sees that we are parked. Pairs with the fences
+        // in IdleWorkers::wake and IdleWorkers::wakeOne.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!parked.load(std::memory_order_acquire))
+            break;
+
+        if (stopping.load(std::memory_order_relaxed)) {
+            idleWorkers.unpark(this);
+            break;
         }
+
+        if (hasWork()) {
+            // Go looking for it, even if there are other thieves. Otherwise we would
+            // park and find the same work again.
+            if (idleWorkers.unpark(this) && !retired.load(std::memory_order_relaxed)) {
+                idleWorkers.startSpinning(true);
+                spinning = true;
+            }
+            break;
+        }
+
+        // A retired scheduler might sleep for a long time, give the cached stacks to the others.
+        if (retired.load(std::memory_order_relaxed))
+            stashClear();
+
+        // Sleep until an IO event or a wakeup. IO callbacks might resume tasks, so check again.
+        ioContext().wait();
+    }
+
+    if (wokenSpinning.exchange(false, std::memory_order_acquire)) {
+        if (spinning) {
+            idleWorkers.stopSpinning(false);
+        }
+        spinning = true;
     }
 }
 
+bool MultiTaskScheduler::hasWork() {
+    if (!remotePinnedTasks.empty() || !pinnedDeadlineTasks.empty())
+        return true;
+    for (const Queues& level : queues) {
+        if (!level.pinnedSoftTasks.empty() || !level.pinnedHardTasks.empty()
+            || level.preferredCount.load(std::memory_order_relaxed) != 0)
+            return true;
+    }
+
+    // A retired scheduler has to hand over its unpinned tasks, but doesn't look for other work.
+    // Neither does a shard.
+    if (sharded || retired.load(std::memory_order_relaxed))
+        return hasStealableWork();
+
+    for (MultiTaskScheduler* scheduler : peers()) {
+        if (scheduler->hasStealableWork())
+            return true;
+    }
+
+    return false;
+}
+
+bool MultiTaskScheduler::hasStealableWork() const {
+    for (const Queues& level : queues) {
+        if (!level.softTasks.empty() || !level.hardTasks.empty()
+            || level.preferredCount.load(std::memory_order_relaxed) != 0)
+            return true;
+    }
+    for (Inbox* inbox = inboxes.load(std::memory_order_acquire); inbox != nullptr; inbox = inbox->next) {
+        if (!inbox->tasks.empty())
+            return true;
+    }
+    return !remoteTasks.empty() || runNext.load(std::memory_order_relaxed) != nullptr
+        || deadlineCount.load(std::memory_order_relaxed) != 0;
+}
+
 MultiTaskScheduler::Priority MultiTaskScheduler::choosePriority(MultiTaskScheduler::Priority preferred) {
     if (sameStreak >= sameStreakLimit) {
         sameStreak = 0;
@@ -190,10 +1094,11 @@ void MultiTaskScheduler::ownedLoop() {
 
     // If we are in the ownedLoop we must be executing a task.
     assert(self->currentTask_ != nullptr);
+    self->endSlice();
 
     // If the scheduler is stopping return to the initial context.
     if (self->stopping.load(std::memory_order_consume)) {
-        boost::context::jump_fcontext(&self->currentTask_->context, self->initialContext, 0);
+        jumpContext(&self->currentTask_->context, self->initialContext, 0, true);
         return;
     }
 
@@ -204,37 +1109,109 @@ void MultiTaskScheduler::ownedLoop() {
     self->currentTask_ = nullptr;
 
     Priority priority = self->choosePriority(Hard);
-    // Try to find a task, prefferably a hard one.
-    self->dequeue(self->currentTask_, priority);
+    // Try to find a task, prefferably a hard one. If we have no tasks, try to steal some.
+    self->take(self->currentTask_, priority);
+
+    // Actors with non-blocking handlers process their events right here, on the rest of the stack of
+    // the suspending task. Its suspension is finished after we leave the stack, so it can't run meanwhile.
+    uint64_t processedInline = 0;
+    while (processedInline < inlineLimit && self->currentTask_ != nullptr
+            && processesInline(self->currentTask_, self->suspendingTask->stack)) {
+        self->processInline(self->suspendingTask->stack);
+        self->currentTask_ = nullptr;
+        processedInline += 1;
 
-    // If we have no tasks, try to steal some.
-    if (self->currentTask_ == nullptr)
-        self->steal(self->currentTask_, priority);
+        priority = self->choosePriority(Hard);
+        self->take(self->currentTask_, priority);
+    }
+
+    // If the handlers resumed the suspending task and there is nothing else to do, it just carries on.
+    if (processedInline != 0 && self->currentTask_ == nullptr) {
+        std::unique_lock<Spinlock> lock(self->suspendingTask->spinlock);
+        if (self->suspendingTask->resumes != self->suspendingTask->resumesExpected) {
+            self->currentTask_ = self->suspendingTask;
+            self->suspendingTask = nullptr;
+            lock.unlock();
+            self->beginSlice();
+            return;
+        }
+    }
+
+    // Someone else has to look for the remaining work.
+    if (self->currentTask_ != nullptr)
+        self->stopSpinning();
 
     // If we still don't have any task, jump into an unowned context.
     if (self->currentTask_ == nullptr) {
         self->sameStreak = 0;
-        self->unowned = self->stashGet();
-        boost::context::jump_fcontext(&self->suspendingTask->context, self->unowned->context, 0);
+        self->unowned = self->stashGet(StackPool::sizeClass(0));
+        jumpContext(&self->suspendingTask->context, self->unowned->context, 0, restoresFpu(self->suspendingTask));
     } else {
         // We got a task, execute it.
-        if (self->currentTask_->status == Starting || self->currentTask_->status == Listening) {
+        if (self->takenStatus == Starting || self->takenStatus == Listening) {
             // We cannot start a new task on an owned stack. Let's get a new stack and jump to it.
             self->sameStreak = 0;
-            self->unowned = self->stashGet();
-            boost::context::jump_fcontext(&self->suspendingTask->context, self->unowned->context, 0);
-        } else if (self->currentTask_->status == Suspended) {
+            self->unowned = self->stashGet(StackPool::sizeClass(self->currentTask_->stackSize));
+            jumpContext(&self->suspendingTask->context, self->unowned->context, 0,
+                restoresFpu(self->suspendingTask));
+        } else if (self->takenStatus == Suspended) {
             // Jump back to a suspended task.
             self->sameStreak += 1;
-            boost::context::jump_fcontext(&self->suspendingTask->context, self->currentTask_->context, 0);
+            jumpContext(&self->suspendingTask->context, self->currentTask_->context, 0,
+                restoresFpu(self->suspendingTask) || restoresFpu(self->currentTask_));
         } else {
             // Impossible.
             __builtin_unreachable();
         }
     }
 
+    finishSwitching();
+}
+
+void MultiTaskScheduler::processInline(const boost::context::stack_context& stack) {
+    Task* task = currentTask_;
+    std::unique_lock<Spinlock> lock(task->spinlock);
+    if (!task->scheduled || task->status != Listening) {
+        discard(task, std::move(lock));
+        return;
+    }
+    task->status = Running;
+    task->scheduled = false;
+    task->lastScheduler = this;
+    task->stack = stack;
+
+    inlineTask = task;
+    beginSlice();
+    try {
+        context::detail::advance(lock);
+    } catch (...) {
+        // Stop the task if an exception escapes.
+        assert(!lock.owns_lock());
+        lock.lock();
+        task->stopped = true;
+    }
+    endSlice();
+    inlineTask = nullptr;
+
+    // If the task is not stopped put it back to listening, otherwise kill it.
+    assert(lock.owns_lock());
+    if (!task->stopped) {
+        task->status = Listening;
+
+        // Reschedule the task if required.
+        if (task->resumesExpected != task->resumes) {
+            resume(task, std::move(lock));
+        } else {
+            lock.unlock();
+        }
+    } else {
+        kill(task, std::move(lock));
+    }
+}
+
+void MultiTaskScheduler::finishSwitching() {
     // Restore self after running a task, in case the context got migrated.
-    self = static_cast<MultiTaskScheduler*>(current());
+    MultiTaskScheduler* self = static_cast<MultiTaskScheduler*>(current());
 
     // We might have to finish suspending a task if one jumeped to us.
     self->finishSuspending();
@@ -245,12 +1222,9 @@ void MultiTaskScheduler::ownedLoop() {
         self->unowned = nullptr;
     }
 
-    // Change the status of the current task.
-    std::unique_lock<Spinlock> lock(self->currentTask_->spinlock);
-    assert(self->currentTask_->status == Suspended);
-    assert(self->currentTask_->scheduled);
-    self->currentTask_->status = Running;
-    self->currentTask_->scheduled = false;
+    // The current task was claimed before we jumped to it.
+    assert(self->currentTask_->status == Running);
+    self->beginSlice();
 }
 
 void MultiTaskScheduler::unownedLoop() {
@@ -259,9 +1233,15 @@ void MultiTaskScheduler::unownedLoop() {
         // Refresh self, in case we got migrated.
         MultiTaskScheduler* self = static_cast<MultiTaskScheduler*>(current());
 
+        // Stash the context we left for a stack of another size.
+        if (self->replacedUnowned != nullptr) {
+            self->stashPut(self->replacedUnowned);
+            self->replacedUnowned = nullptr;
+        }
+
         // If the scheduler is stopping return to the initial context.
         if (self->stopping.load(std::memory_order_consume)) {
-            boost::context::jump_fcontext(&self->unowned->context, self->initialContext, 0);
+            jumpContext(&self->unowned->context, self->initialContext, 0, true);
             continue;
         }
 
@@ -272,25 +1252,46 @@ void MultiTaskScheduler::unownedLoop() {
         self->finishSuspending();
 
         Priority priority = self->choosePriority(Soft);
-        // If there was no assigned task, try to get one.
-        if (self->currentTask_ == nullptr)
-            self->dequeue(self->currentTask_, priority);
-
-        // If we have no tasks, try to steal some.
+        // If there was no assigned task, try to get one or steal some.
         if (self->currentTask_ == nullptr)
-            self->steal(self->currentTask_, priority);
+            self->take(self->currentTask_, priority);
 
-        // If we still don't have any task, try again or go to sleep,
-        // depending on how long are we spinning.
+        // If we still don't have any task keep looking for a while, then park.
         if (self->currentTask_ == nullptr) {
-            self->idle(idleStreak);
+            if (self->spinning && idleStreak < spinLimit) {
+                idleStreak += 1;
+            } else {
+                idleStreak = 0;
+                self->park();
+            }
             continue;
         } else {
             idleStreak = 0;
+            self->stopSpinning();
         }
 
-        TaskStatus status = self->currentTask_->status;
-        if (status == Starting || status == Listening) {
+        TaskStatus status = self->takenStatus;
+        uint8_t sizeClass = StackPool::sizeClass(self->currentTask_->stackSize);
+        if (processesInline(self->currentTask_, self->unowned->stack)) {
+            // The handlers don't suspend, the context stays unowned.
+            self->sameStreak += 1;
+            self->processInline(self->unowned->stack);
+            self->currentTask_ = nullptr;
+        } else if ((status == Starting || status == Listening) && self->unowned->sizeClass != sizeClass) {
+            // The task needs a stack of another size, continue on a context with the right one.
+            self->sameStreak = 0;
+            self->replacedUnowned = self->unowned;
+            self->unowned = self->stashGet(sizeClass);
+            jumpContext(&self->replacedUnowned->context, self->unowned->context, 0, false);
+        } else if (status == Starting || status == Listening) {
+            // Another copy of the task might have taken it, see escalate().
+            std::unique_lock<Spinlock> lock(self->currentTask_->spinlock);
+            if (!self->currentTask_->scheduled || self->currentTask_->status != status) {
+                self->discard(self->currentTask_, std::move(lock));
+                self->currentTask_ = nullptr;
+                continue;
+            }
+
             self->sameStreak += 1;
 
             // The context becomes owned.
@@ -298,11 +1299,13 @@ void MultiTaskScheduler::unownedLoop() {
             self->unowned = nullptr;
 
             // Change the status.
-            std::unique_lock<Spinlock> lock(self->currentTask_->spinlock);
             self->currentTask_->status = Running;
             self->currentTask_->scheduled = false;
+            self->currentTask_->lastScheduler = self;
             self->currentTask_->context = unowned->context;
+            self->currentTask_->stack = unowned->stack;
 
+            self->beginSlice();
             if (status == Starting) {
                 // Execute the task.
                 lock.unlock();
@@ -311,7 +1314,7 @@ void MultiTaskScheduler::unownedLoop() {
             } else if (status == Listening) {
                 // Process events.
                 try {
-                    context::detail::process(lock);
+                    context::detail::advance(lock);
                 } catch (...) {
                     // Stop the task if an exception escapes.
                     assert(!lock.owns_lock());
@@ -325,10 +1328,19 @@ void MultiTaskScheduler::unownedLoop() {
 
             // Restore self after running a task, in case the context got migrated.
             self = static_cast<MultiTaskScheduler*>(current());
+            self->endSlice();
 
             // The context becomes unowned again.
             self->unowned = unowned;
 
+            // Measure the stack used by this run. The path is copied, the task might die below.
+            size_t stackUsed = 0;
+            Path stackUser;
+            if (self->stackProfile != nullptr) {
+                stackUsed = StackPool::measure(unowned->stack);
+                stackUser = self->currentTask_->path;
+            }
+
             // Change the status of the task.
             assert(lock.owns_lock());
             assert(self->currentTask_->status == Running);
@@ -348,13 +1360,16 @@ void MultiTaskScheduler::unownedLoop() {
                 kill(self->currentTask_, std::move(lock));
             }
 
+            if (self->stackProfile != nullptr)
+                self->stackProfile->record(stackUser, stackUsed, unowned->stack.size);
+
             self->currentTask_ = nullptr;
-        } else if (self->currentTask_->status == Suspended) {
+        } else if (status == Suspended) {
             self->sameStreak = 0;
 
             // Too bad, the task is suspended. This means we have to context switch, therefore
             // wasting our current context.
-            boost::context::jump_fcontext(&self->unowned->context, self->currentTask_->context, 0);
+            jumpContext(&self->unowned->context, self->currentTask_->context, 0, restoresFpu(self->currentTask_));
         } else {
             // Impossible.
             __builtin_unreachable();
@@ -362,17 +1377,35 @@ void MultiTaskScheduler::unownedLoop() {
     }
 }
 
-MultiTaskScheduler::UnownedContext* MultiTaskScheduler::stashGet() {
-    UnownedContext* context;
+/**
+ * How many stacks of the given class a scheduler keeps for itself.
+ */
+static size_t stashSize(uint8_t sizeClass) {
+    return std::min<size_t>(std::max<size_t>(stashBytes / StackPool::classSize(sizeClass), 2), 64);
+}
+
+UnownedContext* MultiTaskScheduler::stashGet(uint8_t sizeClass) {
+    std::vector<UnownedContext*>& stash = stashes[sizeClass];
 
+    // Refill from the shared pool.
+    if (stash.empty()) {
+        size_t batch = stashSize(sizeClass) / 2;
+        stash.resize(batch);
+        stash.resize(stackPool.take(index_, sizeClass, stash.data(), batch));
+    }
+
+    UnownedContext* context;
     if (!stash.empty()) {
         context = stash.back();
         stash.pop_back();
     } else {
         // Create a new context.
         context = new UnownedContext;
-        context->stack = stackAllocator.allocate();
-        context->context = boost::context::make_fcontext(context->stack.sp, context->stack.size, [] (intptr_t) {
+        context->stack = stackPool.allocate(sizeClass);
+        context->sizeClass = sizeClass;
+        context->released = false;
+        stackPool.paint(context->stack);
+        context->context = makeContext(context->stack.sp, context->stack.size, [] (intptr_t) {
             unownedLoop();
         });
     }
@@ -382,20 +1415,22 @@ MultiTaskScheduler::UnownedContext* MultiTaskScheduler::stashGet() {
 
 void MultiTaskScheduler::stashPut(UnownedContext* context) {
     assert(context != nullptr);
-    if (stash.size() < stashSize) {
-        stash.push_back(context);
-    } else {
-        stackAllocator.deallocate(context->stack);
-        delete context;
+    std::vector<UnownedContext*>& stash = stashes[context->sizeClass];
+    stash.push_back(context);
+
+    // Hand the coldest stacks over to the shared pool.
+    size_t limit = stashSize(context->sizeClass);
+    if (stash.size() > limit) {
+        stackPool.give(index_, stash.data(), limit / 2);
+        stash.erase(stash.begin(), stash.begin() + limit / 2);
     }
 }
 
 void MultiTaskScheduler::stashClear() {
-    for (UnownedContext* context : stash) {
-        stackAllocator.deallocate(context->stack);
-        delete context;
+    for (std::vector<UnownedContext*>& stash : stashes) {
+        stackPool.give(index_, stash.data(), stash.size());
+        stash.clear();
     }
-    stash.clear();
 }
 
 } // namespace detail
@@ -5,21 +5,88 @@
  * @copyright 2015 Paweł Nowak
  */
 #include <fiberize/detail/runner.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
 #include <fiberize/detail/singletaskscheduler.hpp>
+#include <fiberize/detail/stackprofile.hpp>
 #include <fiberize/detail/task.hpp>
 #include <fiberize/context.hpp>
+#include <fiberize/fibersystem.hpp>
 
 #include <thread>
 
 namespace fiberize {
 namespace detail {
 
-void runTaskAsMicrothread(Task* task) {
+/**
+ * Chooses the scheduler for a new task, or returns nullptr to let resume decide.
+ */
+static MultiTaskScheduler* place(Task* task, Placement placement) {
+    if (placement == Placement::Local || task->pin != nullptr || task->preferred != nullptr)
+        return nullptr;
+
+    const auto& schedulers = context::system()->schedulersIn(task->pool);
+    switch (placement) {
+        case Placement::RoundRobin: {
+            // Each spawning thread walks over the schedulers from a random starting point.
+            static thread_local uint64_t turn = context::random()();
+            return schedulers[turn++ % schedulers.size()];
+        }
+
+        case Placement::LeastLoaded: {
+            std::uniform_int_distribution<size_t> dist(0, schedulers.size() - 1);
+            MultiTaskScheduler* first = schedulers[dist(context::random())];
+            MultiTaskScheduler* second = schedulers[dist(context::random())];
+            return first->load() <= second->load() ? first : second;
+        }
+
+        case Placement::Hashed:
+            return schedulers[boost::hash<Path>()(task->path) % schedulers.size()];
+
+        default:
+            return nullptr;
+    }
+}
+
+/**
+ * In a sharded system pins a task in the default pool to the shard that started it.
+ */
+static void pinToShard(Task* task) {
+    FiberSystem* system = context::system();
+    if (!system->config().sharded || task->pin != nullptr || task->pool != nullptr)
+        return;
+
+    Scheduler* current = Scheduler::current();
+    if (current != nullptr && current->isMultiTasking()
+        && static_cast<MultiTaskScheduler*>(current)->pool() == nullptr) {
+        task->pin = current;
+    } else {
+        task->pin = system->shard(system->shardOf(task->path));
+    }
+}
+
+/**
+ * Gives a task without an explicit stack size the size measured for its name.
+ */
+static void rightSizeStack(Task* task) {
+    FiberSystem* system = context::system();
+    if (system->config().stackProfiling && system->config().stackRightSizing && task->stackSize == 0)
+        task->stackSize = system->stackProfile().recommended(task->path);
+}
+
+void runTaskAsMicrothread(Task* task, Placement placement) {
+    rightSizeStack(task);
     std::unique_lock<Spinlock> lock(task->spinlock);
-    context::detail::resume(task, std::move(lock));
+    pinToShard(task);
+    MultiTaskScheduler* scheduler = place(task, placement);
+    if (scheduler != nullptr) {
+        task->resumes += 1;
+        scheduler->resume(task, std::move(lock));
+    } else {
+        context::detail::resume(task, std::move(lock));
+    }
 }
 
-void runTaskAsOSThread(Task* task) {
+void runTaskAsOSThread(Task* task, Placement) {
     FiberSystem* system = context::system();
     std::uniform_int_distribution<uint64_t> seedDist;
     uint64_t seed = seedDist(context::random());
@@ -29,25 +96,26 @@ void runTaskAsOSThread(Task* task) {
         std::unique_ptr<SingleTaskScheduler> scheduler{new SingleTaskScheduler(system, seed, task)};
         scheduler->makeCurrent();
 
+        // The task is running, events sent to it are only queued until it suspends.
+        std::unique_lock<Spinlock> startLock(task->spinlock);
+        task->status = Running;
+        task->scheduled = false;
+        startLock.unlock();
+
         // Run the task. This doesn't throw.
         task->runnable->run();
 
-        // Process events.
+        // Process events, sleeping when the mailbox is empty.
         try {
-            uint64_t idleStreak = 0;
+            std::unique_lock<Spinlock> lock(task->spinlock);
             while (!task->stopped) {
-                scheduler->idle(idleStreak);
+                context::detail::advance(lock);
+                if (task->stopped)
+                    break;
 
-                std::unique_lock<Spinlock> lock(task->spinlock);
-                if (!task->mailbox->empty()) {
-                    context::detail::process(lock);
-                    idleStreak = 0;
-                }
                 lock.unlock();
-
-                if (scheduler->ioContext().poll()) {
-                    idleStreak = 0;
-                }
+                scheduler->suspend();
+                lock.lock();
             }
         } catch (...) {
             // Nothing,
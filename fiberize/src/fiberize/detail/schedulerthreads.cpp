@@ -0,0 +1,74 @@
+/**
+ * OS threads running the multitasking schedulers.
+ *
+ * @file schedulerthreads.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/schedulerthreads.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+#include <fiberize/detail/stackguard.hpp>
+
+namespace fiberize {
+namespace detail {
+
+SchedulerThreads::SchedulerThreads() : standby(0), stopping(false) {}
+
+SchedulerThreads::~SchedulerThreads() {
+    stop();
+}
+
+void SchedulerThreads::run(MultiTaskScheduler* scheduler) {
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.push_back(scheduler);
+
+    // A thread woken earlier might not have taken its scheduler yet, so this can
+    // create a thread too many, but never too few.
+    if (standby >= pending.size()) {
+        condition.notify_one();
+    } else {
+        threads.emplace_back([this] () {
+            work();
+        });
+    }
+}
+
+void SchedulerThreads::stop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+    condition.notify_all();
+    std::vector<std::thread> joined = std::move(threads);
+    threads.clear();
+    lock.unlock();
+
+    for (auto& thread : joined) {
+        thread.join();
+    }
+}
+
+void SchedulerThreads::work() {
+    // Overflows of the task stacks are reported on a stack of their own.
+    AlternateSignalStack signalStack;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        while (pending.empty() && !stopping) {
+            standby += 1;
+            condition.wait(lock);
+            standby -= 1;
+        }
+
+        if (pending.empty())
+            return;
+
+        MultiTaskScheduler* scheduler = pending.front();
+        pending.pop_front();
+        lock.unlock();
+
+        scheduler->run();
+
+        lock.lock();
+    }
+}
+
+} // namespace detail
+} // namespace fiberize
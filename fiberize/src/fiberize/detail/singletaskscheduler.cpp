@@ -12,9 +12,13 @@
 namespace fiberize {
 namespace detail {
 
+constexpr uint64_t spinLimit = 64;
+
 SingleTaskScheduler::SingleTaskScheduler(FiberSystem* system, uint64_t seed, Task* task)
     : Scheduler(system, seed)
-    , task_(task) {
+    , task_(task)
+    , resumed(false)
+    , sleeping(false) {
     task->pin = this;
 }
 
@@ -30,7 +34,11 @@ void SingleTaskScheduler::resume(std::unique_lock<Spinlock> lock) {
     task_->status = Running;
     task_->scheduled = false;
     task_->resumes += 1;
-    resumed.store(true, std::memory_order_release);
+    resumed.store(true, std::memory_order_seq_cst);
+
+    // Wake the thread while holding the lock, the scheduler can't go away until we release it.
+    if (sleeping.load(std::memory_order_seq_cst))
+        ioContext().wakeup();
     lock.unlock();
 }
 
@@ -49,14 +57,19 @@ void SingleTaskScheduler::suspend() {
     lock.unlock();
 
     /**
-     * Loop until someone breaks it.
+     * Spin for a while, then sleep in the IO loop until someone resumes us.
      */
     uint64_t idleStreak = 0;
     while (!resumed.load(std::memory_order_acquire)) {
-        if (ioContext().poll()) {
-            idleStreak = 0;
+        if (idleStreak < spinLimit) {
+            ioContext().poll();
+            std::this_thread::yield();
+            idleStreak += 1;
         } else {
-            idle(idleStreak);
+            sleeping.store(true, std::memory_order_seq_cst);
+            if (!resumed.load(std::memory_order_seq_cst))
+                ioContext().wait();
+            sleeping.store(false, std::memory_order_relaxed);
         }
     }
 }
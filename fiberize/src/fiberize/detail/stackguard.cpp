@@ -0,0 +1,119 @@
+/**
+ * Detection of microthread stack overflows.
+ *
+ * @file stackguard.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/stackguard.hpp>
+#include <fiberize/detail/task.hpp>
+#include <fiberize/scheduler.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * Big enough to format the report.
+ */
+constexpr size_t alternateStackSize = 64 * 1024;
+
+/**
+ * How far below the stack the stack pointer of an overflowing task can be.
+ */
+constexpr uintptr_t overflowReach = 1024 * 1024;
+
+static struct sigaction previousAction;
+
+/**
+ * Returns the stack pointer of the interrupted code, or 0 if it's unknown on this platform.
+ */
+static uintptr_t stackPointer(void* ucontext) {
+#if defined(__x86_64__)
+    return static_cast<ucontext_t*>(ucontext)->uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+    return static_cast<ucontext_t*>(ucontext)->uc_mcontext.sp;
+#else
+    (void) ucontext;
+    return 0;
+#endif
+}
+
+/**
+ * Whether the fault was caused by running out of the stack of the task. A frame bigger than
+ * a page can jump over the guard page, so the stack pointer is checked as well.
+ */
+static bool isOverflow(const Task* task, uintptr_t address, uintptr_t sp) {
+    if (task->stack.sp == nullptr)
+        return false;
+
+    uintptr_t bottom = reinterpret_cast<uintptr_t>(task->stack.sp) - task->stack.size;
+    uintptr_t guard = boost::context::stack_traits::page_size();
+    return (address < bottom && address >= bottom - guard)
+        || (sp != 0 && sp < bottom && sp >= bottom - overflowReach);
+}
+
+static void stackOverflowHandler(int signal, siginfo_t* info, void* ucontext) {
+    Scheduler* scheduler = Scheduler::current();
+    Task* task = scheduler != nullptr ? scheduler->currentTask() : nullptr;
+    if (task != nullptr && isOverflow(task, reinterpret_cast<uintptr_t>(info->si_addr), stackPointer(ucontext))) {
+        // The process is going down anyway, so it's fine to allocate here.
+        std::cerr << "fiberize: stack overflow in task " << toString(task->path)
+            << ", stack size " << task->stack.size << " bytes" << std::endl;
+        std::abort();
+    }
+
+    // Not a stack overflow, let the previous handler deal with it.
+    if (previousAction.sa_flags & SA_SIGINFO) {
+        previousAction.sa_sigaction(signal, info, ucontext);
+    } else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN) {
+        previousAction.sa_handler(signal);
+    } else {
+        // Restore the default action, the faulting instruction runs again and triggers it.
+        sigaction(signal, &previousAction, nullptr);
+    }
+}
+
+void installStackOverflowHandler() {
+    static std::once_flag installed;
+    std::call_once(installed, [] () {
+        struct sigaction action = {};
+        action.sa_sigaction = stackOverflowHandler;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previousAction);
+    });
+}
+
+AlternateSignalStack::AlternateSignalStack() : memory(nullptr), size(alternateStackSize) {
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        // Without the alternate stack overflows are not reported, but everything else works.
+        memory = nullptr;
+        return;
+    }
+
+    stack_t stack = {};
+    stack.ss_sp = memory;
+    stack.ss_size = size;
+    sigaltstack(&stack, nullptr);
+}
+
+AlternateSignalStack::~AlternateSignalStack() {
+    if (memory == nullptr)
+        return;
+
+    stack_t stack = {};
+    stack.ss_flags = SS_DISABLE;
+    sigaltstack(&stack, nullptr);
+    munmap(memory, size);
+}
+
+} // namespace detail
+} // namespace fiberize
@@ -0,0 +1,271 @@
+/**
+ * Pool of microthread stacks shared by the schedulers.
+ *
+ * @file stackpool.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/stackpool.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <new>
+
+#include <sys/mman.h>
+
+#ifdef FIBERIZE_VALGRIND
+#include <valgrind/valgrind.h>
+#endif
+
+namespace fiberize {
+namespace detail {
+
+/**
+ * MADV_FREE lets the kernel take the pages lazily, which is cheaper when the stack is reused soon.
+ */
+#ifdef MADV_FREE
+constexpr int releaseAdvice = MADV_FREE;
+#else
+constexpr int releaseAdvice = MADV_DONTNEED;
+#endif
+
+/**
+ * Pattern painted over unused stacks.
+ */
+constexpr uint64_t canary = 0xfdfdfdfdfdfdfdfdull;
+
+/**
+ * Space below the frame of measure() left for the functions it calls.
+ */
+constexpr uintptr_t measureMargin = 512;
+
+constexpr uint8_t StackPool::sizeClasses;
+constexpr size_t StackPool::minSize;
+
+/**
+ * Finds the smallest class fitting the given size.
+ */
+static uint8_t fittingClass(size_t size) {
+    uint8_t sizeClass = 0;
+    while (sizeClass + 1 < StackPool::sizeClasses && StackPool::classSize(sizeClass) < size) {
+        sizeClass += 1;
+    }
+    return sizeClass;
+}
+
+/**
+ * Returns how many stacks can be guarded. A guarded stack takes two memory mappings, at most half
+ * of the kernel's limit goes to them, the rest is left for everything else in the process.
+ */
+static uint64_t guardableStacks() {
+    uint64_t maxMapCount = 65530;
+    std::ifstream("/proc/sys/vm/max_map_count") >> maxMapCount;
+    return maxMapCount / 4;
+}
+
+uint8_t StackPool::sizeClass(size_t size) {
+    static const uint8_t defaultClass = fittingClass(boost::context::stack_traits::default_size());
+    return size == 0 ? defaultClass : fittingClass(size);
+}
+
+StackPool::StackPool(uint32_t shards, uint64_t lowWatermark, uint64_t highWatermark, bool guardPages, bool painting)
+    : guardSize(guardPages ? boost::context::stack_traits::page_size() : 0)
+    , guardedLimit(guardPages ? guardableStacks() : 0)
+    , painting(painting)
+    , shardCount(std::max(shards, 1u))
+    , shards(new Shard[sizeClasses * std::max(shards, 1u)]) {
+    // Scale the watermarks, so that every class keeps about the same amount of memory.
+    highWatermark = std::max(lowWatermark, highWatermark);
+    size_t defaultSize = classSize(sizeClass(0));
+    for (uint8_t i = 0; i < sizeClasses; ++i) {
+        classes[i].lowWatermark = lowWatermark * defaultSize / classSize(i);
+        classes[i].highWatermark = highWatermark * defaultSize / classSize(i);
+        if (highWatermark != 0)
+            classes[i].highWatermark = std::max<uint64_t>(classes[i].highWatermark, 1);
+    }
+}
+
+StackPool::~StackPool() {
+    for (uint32_t i = 0; i < sizeClasses * shardCount; ++i) {
+        for (UnownedContext* context : shards[i].contexts) {
+            destroy(context);
+        }
+    }
+}
+
+boost::context::stack_context StackPool::allocate(uint8_t sizeClass) {
+    size_t size = classSize(sizeClass);
+    classes[sizeClass].allocated.fetch_add(1, std::memory_order_relaxed);
+#ifdef FIBERIZE_SEGMENTED_STACKS
+    return boost::context::segmented_stack(size).allocate();
+#else
+    bool guarded = guardSize != 0 && stats().allocated <= guardedLimit;
+
+    // Don't reserve swap for the whole stack, pages are committed when a task touches them.
+    void* memory = mmap(nullptr, guardSize + size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        classes[sizeClass].allocated.fetch_sub(1, std::memory_order_relaxed);
+        throw std::bad_alloc();
+    }
+
+    // An unguarded stack keeps the same layout, so that it is unmapped the same way. Unlike guarded
+    // stacks, neighbouring unguarded stacks are merged into one mapping by the kernel. A failing
+    // mprotect leaves the stack usable, only an overflow goes unnoticed.
+    if (guarded)
+        mprotect(memory, guardSize, PROT_NONE);
+
+    boost::context::stack_context stack;
+    stack.size = size;
+    stack.sp = static_cast<char*>(memory) + guardSize + size;
+#ifdef FIBERIZE_VALGRIND
+    stack.valgrind_stack_id = VALGRIND_STACK_REGISTER(stack.sp, static_cast<char*>(memory) + guardSize);
+#endif
+    return stack;
+#endif
+}
+
+void StackPool::deallocate(boost::context::stack_context& stack) {
+    classes[fittingClass(stack.size)].allocated.fetch_sub(1, std::memory_order_relaxed);
+#ifdef FIBERIZE_SEGMENTED_STACKS
+    boost::context::segmented_stack(stack.size).deallocate(stack);
+#else
+#ifdef FIBERIZE_VALGRIND
+    VALGRIND_STACK_DEREGISTER(stack.valgrind_stack_id);
+#endif
+    munmap(static_cast<char*>(stack.sp) - stack.size - guardSize, guardSize + stack.size);
+#endif
+}
+
+size_t StackPool::take(uint32_t shard, uint8_t sizeClass, UnownedContext** contexts, size_t max) {
+    Shard* sources = shardsOf(sizeClass);
+    size_t taken = 0;
+    for (uint32_t i = 0; i < shardCount && taken < max; ++i) {
+        Shard& source = sources[(shard + i) % shardCount];
+        if (source.size.load(std::memory_order_relaxed) == 0)
+            continue;
+
+        std::lock_guard<Spinlock> lock(source.spinlock);
+        while (taken < max && !source.contexts.empty()) {
+            contexts[taken++] = source.contexts.back();
+            source.contexts.pop_back();
+        }
+        source.size.store(source.contexts.size(), std::memory_order_relaxed);
+    }
+
+    Class& counters = classes[sizeClass];
+    for (size_t i = 0; i < taken; ++i) {
+        // The released pages come back zeroed on the first touch.
+        if (contexts[i]->released) {
+            contexts[i]->released = false;
+            counters.released.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    counters.pooled.fetch_sub(taken, std::memory_order_relaxed);
+    return taken;
+}
+
+void StackPool::give(uint32_t shard, UnownedContext* const* contexts, size_t count) {
+    std::vector<UnownedContext*> kept;
+    kept.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        UnownedContext* context = contexts[i];
+        Class& counters = classes[context->sizeClass];
+        uint64_t occupancy = counters.pooled.fetch_add(1, std::memory_order_relaxed);
+        if (occupancy >= counters.highWatermark) {
+            counters.pooled.fetch_sub(1, std::memory_order_relaxed);
+            destroy(context);
+            continue;
+        }
+
+        if (occupancy >= counters.lowWatermark && !context->released && !painting) {
+            release(context);
+            context->released = true;
+            counters.released.fetch_add(1, std::memory_order_relaxed);
+        }
+        kept.push_back(context);
+    }
+
+    // Take each lock once per run of contexts of the same class.
+    std::stable_sort(kept.begin(), kept.end(), [] (UnownedContext* a, UnownedContext* b) {
+        return a->sizeClass < b->sizeClass;
+    });
+    for (auto run = kept.begin(); run != kept.end(); ) {
+        auto end = std::find_if(run, kept.end(), [run] (UnownedContext* context) {
+            return context->sizeClass != (*run)->sizeClass;
+        });
+
+        Shard& target = shardsOf((*run)->sizeClass)[shard % shardCount];
+        std::lock_guard<Spinlock> lock(target.spinlock);
+        target.contexts.insert(target.contexts.end(), run, end);
+        target.size.store(target.contexts.size(), std::memory_order_relaxed);
+        run = end;
+    }
+}
+
+void StackPool::paint(const boost::context::stack_context& stack) {
+    if (!painting)
+        return;
+
+    uint64_t* bottom = reinterpret_cast<uint64_t*>(static_cast<char*>(stack.sp) - stack.size);
+    std::fill(bottom, reinterpret_cast<uint64_t*>(stack.sp), canary);
+}
+
+size_t StackPool::measure(const boost::context::stack_context& stack) {
+    uint64_t* bottom = reinterpret_cast<uint64_t*>(static_cast<char*>(stack.sp) - stack.size);
+    uint64_t* top = reinterpret_cast<uint64_t*>(stack.sp);
+    uint64_t* used = std::find_if(bottom, top, [] (uint64_t word) { return word != canary; });
+
+    // Paint the used part again, but stay away from the frames still in use.
+    uintptr_t frame = reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) - measureMargin;
+    uint64_t* limit = reinterpret_cast<uint64_t*>(frame & ~uintptr_t(sizeof(uint64_t) - 1));
+    if (used < limit)
+        std::fill(used, limit, canary);
+
+    return reinterpret_cast<char*>(top) - reinterpret_cast<char*>(used);
+}
+
+StackPool::Stats StackPool::stats() const {
+    Stats total = {0, 0, 0};
+    for (uint8_t i = 0; i < sizeClasses; ++i) {
+        Stats stats = this->stats(i);
+        total.allocated += stats.allocated;
+        total.pooled += stats.pooled;
+        total.released += stats.released;
+    }
+    return total;
+}
+
+StackPool::Stats StackPool::stats(uint8_t sizeClass) const {
+    Stats stats;
+    stats.allocated = classes[sizeClass].allocated.load(std::memory_order_relaxed);
+    stats.pooled = classes[sizeClass].pooled.load(std::memory_order_relaxed);
+    stats.released = classes[sizeClass].released.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void StackPool::release(UnownedContext* context) {
+#ifndef FIBERIZE_SEGMENTED_STACKS
+    // The suspended context lives at the top of the stack, keep its page and the one below it.
+    uintptr_t pageSize = boost::context::stack_traits::page_size();
+    uintptr_t bottom = reinterpret_cast<uintptr_t>(context->stack.sp) - context->stack.size;
+    uintptr_t top = (reinterpret_cast<uintptr_t>(context->context) & ~(pageSize - 1)) - pageSize;
+    if (top > bottom) {
+        // Releasing is only an optimization, ignore failures.
+        madvise(reinterpret_cast<void*>(bottom), top - bottom, releaseAdvice);
+    }
+#else
+    (void) context;
+#endif
+}
+
+void StackPool::destroy(UnownedContext* context) {
+    if (context->released)
+        classes[context->sizeClass].released.fetch_sub(1, std::memory_order_relaxed);
+    deallocate(context->stack);
+    delete context;
+}
+
+} // namespace detail
+} // namespace fiberize
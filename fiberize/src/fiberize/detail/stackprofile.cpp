@@ -0,0 +1,53 @@
+/**
+ * Measured stack usage of tasks.
+ *
+ * @file stackprofile.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/detail/stackprofile.hpp>
+
+#include <algorithm>
+
+namespace fiberize {
+namespace detail {
+
+constexpr uint64_t StackProfile::minSamples;
+
+/**
+ * Returns the name of the task with the given path, or an empty string if it's unnamed.
+ */
+static std::string taskName(const Path& path) {
+    const PrefixedPath* prefixed = boost::get<PrefixedPath>(&path);
+    if (prefixed == nullptr)
+        return {};
+
+    Ident ident = prefixed->ident();
+    const NamedIdent* named = boost::get<NamedIdent>(&ident);
+    return named != nullptr ? named->name() : std::string();
+}
+
+void StackProfile::record(const Path& path, size_t used, size_t stackSize) {
+    std::string name = taskName(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    Usage& usage = usage_.emplace(std::move(name), Usage{0, 0, 0}).first->second;
+    usage.samples += 1;
+    usage.peak = std::max(usage.peak, used);
+    usage.stackSize = stackSize;
+}
+
+std::map<std::string, StackProfile::Usage> StackProfile::usage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return usage_;
+}
+
+size_t StackProfile::recommended(const Path& path) const {
+    std::string name = taskName(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = usage_.find(name);
+    if (it == usage_.end() || it->second.samples < minSamples)
+        return 0;
+    return 2 * it->second.peak;
+}
+
+} // namespace detail
+} // namespace fiberize
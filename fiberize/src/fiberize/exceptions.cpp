@@ -10,4 +10,12 @@ NullAwaitable::NullAwaitable()
     : runtime_error("The awaitable will never yield a value")
     {}
 
+UnknownPool::UnknownPool(const std::string& pool)
+    : runtime_error("Unknown scheduler pool: " + pool)
+    {}
+
+ShardedResize::ShardedResize()
+    : runtime_error("A sharded fiber system cannot be resized")
+    {}
+
 } // namespace fiberize
@@ -1,22 +1,70 @@
 #include <fiberize/fibersystem.hpp>
 #include <fiberize/context.hpp>
+#include <fiberize/exceptions.hpp>
 #include <fiberize/detail/multitaskscheduler.hpp>
+#include <fiberize/detail/idleworkers.hpp>
+#include <fiberize/detail/schedulerpool.hpp>
+#include <fiberize/detail/schedulerthreads.hpp>
+#include <fiberize/detail/stackguard.hpp>
+#include <fiberize/detail/stackpool.hpp>
+#include <fiberize/detail/stackprofile.hpp>
 
+#include <algorithm>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <set>
+
+#include <signal.h>
 
 #include <boost/uuid/uuid_generators.hpp>
 
 namespace fiberize {
 
-FiberSystem::FiberSystem() : FiberSystem(std::thread::hardware_concurrency()) {}
+static void preemptionSignalHandler(int) {
+    context::detail::preemptRequested.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Installs the preemption handler for the given signal, once per signal. Systems can use different signals.
+ */
+static void installPreemptionSignalHandler(int signal) {
+    static std::mutex mutex;
+    static std::set<int> installed;
 
-FiberSystem::FiberSystem(uint32_t macrothreads)
-    : shuttingDown_(false)
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed.insert(signal).second)
+        return;
+
+    struct sigaction action = {};
+    action.sa_handler = preemptionSignalHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(signal, &action, nullptr);
+}
+
+FiberSystem::FiberSystem() : FiberSystem(FiberSystemConfig()) {}
+
+FiberSystem::FiberSystem(uint32_t macrothreads) : FiberSystem([macrothreads] () {
+    FiberSystemConfig config;
+    config.macrothreads = macrothreads;
+    return config;
+}()) {}
+
+FiberSystem::FiberSystem(const FiberSystemConfig& config)
+    : config_(config)
+    , schedulers_(nullptr)
+    , monitorStopping_(false)
+    , shuttingDown_(false)
 #ifdef FIBERIZE_VALGRIND
     , seedGenerator(std::chrono::system_clock::now().time_since_epoch().count())
 #endif
 {
+    if (!config_.topology)
+        config_.topology = Topology::discover();
+    if (config_.sharded)
+        config_.autoScale = false;
+
     /**
      * Generate the uuid.
      */
@@ -26,24 +74,276 @@ FiberSystem::FiberSystem(uint32_t macrothreads)
     uuid_ = uuidGenerator();
 
     // Spawn the schedulers.
-    for (uint32_t i = 0; i < macrothreads; ++i) {
-        schedulers_.emplace_back(new detail::MultiTaskScheduler(this, seedDist(seedGenerator)));
+    stackPool_.reset(new detail::StackPool(config_.topology->cpus().size(),
+        config_.stackPoolLowWatermark, config_.stackPoolHighWatermark, config_.stackGuardPages,
+        config_.stackProfiling));
+    stackProfile_.reset(new detail::StackProfile);
+    if (config_.stackGuardPages)
+        detail::installStackOverflowHandler();
+    idleWorkers_.reset(new detail::IdleWorkers(config_.macrothreads));
+    schedulerThreads_.reset(new detail::SchedulerThreads);
+    std::unique_lock<std::mutex> lock(resizeMutex_);
+    publish({});
+    lock.unlock();
+    setMacrothreads(config_.macrothreads);
+
+    // Spawn the named pools.
+    for (const auto& entry : config_.pools) {
+        std::unique_ptr<detail::SchedulerPool> pool(new detail::SchedulerPool);
+        pool->name = entry.first;
+        pool->idleWorkers.reset(new detail::IdleWorkers(std::max(entry.second, 1u)));
+        for (uint32_t i = 0; i < std::max(entry.second, 1u); ++i) {
+            std::uniform_int_distribution<uint64_t> seedDist;
+            generatorMutex.lock();
+            uint64_t seed = seedDist(seedGenerator);
+            generatorMutex.unlock();
+
+            uint32_t index = allSchedulers_.size();
+            auto scheduler = new detail::MultiTaskScheduler(this, index, seed);
+            if (config_.pinThreads)
+                scheduler->setCpu(config_.topology->placement(index + 1)[index]);
+            scheduler->setPool(pool.get());
+
+            allSchedulers_.push_back(scheduler);
+            pool->schedulers.push_back(scheduler);
+        }
+        pools_.emplace_back(std::move(pool));
     }
+    for (const auto& pool : pools_) {
+        for (auto scheduler : pool->schedulers) {
+            scheduler->start();
+        }
+    }
+
+    if (config_.preemption == Preemption::Signal)
+        installPreemptionSignalHandler(config_.preemptionSignal);
 
-    for (uint32_t i = 0; i < macrothreads; ++i) {
-        schedulers_[i]->start();
+    if (config_.autoScale || config_.preemption != Preemption::Disabled || config_.blockingHandoff) {
+        monitor_ = std::thread([this] () {
+            monitor();
+        });
     }
 }
 
 FiberSystem::~FiberSystem() {
-    for (auto scheduler : schedulers_) {
+    if (monitor_.joinable()) {
+        std::unique_lock<std::mutex> lock(monitorMutex_);
+        monitorStopping_ = true;
+        lock.unlock();
+        monitorCondition_.notify_one();
+        monitor_.join();
+    }
+
+    for (auto scheduler : allSchedulers_) {
         scheduler->stop();
     }
-    for (auto scheduler : schedulers_) {
+
+    // Threads blocked in tasks might still reschedule them.
+    schedulerThreads_->stop();
+
+    for (auto scheduler : allSchedulers_) {
         delete scheduler;
     }
 }
 
+const std::vector<detail::MultiTaskScheduler*>& FiberSystem::schedulers(const std::string& pool) {
+    return this->pool(pool)->schedulers;
+}
+
+const std::vector<detail::MultiTaskScheduler*>& FiberSystem::schedulersIn(const detail::SchedulerPool* pool) const {
+    return pool != nullptr ? pool->schedulers : schedulers();
+}
+
+detail::SchedulerPool* FiberSystem::pool(const std::string& name) {
+    for (const auto& pool : pools_) {
+        if (pool->name == name)
+            return pool.get();
+    }
+    throw UnknownPool(name);
+}
+
+Scheduler* FiberSystem::shard(uint32_t index) const {
+    return schedulers().at(index);
+}
+
+void FiberSystem::resize(uint32_t macrothreads) {
+    if (config_.sharded)
+        throw ShardedResize();
+    setMacrothreads(macrothreads);
+}
+
+void FiberSystem::setMacrothreads(uint32_t macrothreads) {
+    macrothreads = std::max(macrothreads, 1u);
+    std::lock_guard<std::mutex> lock(resizeMutex_);
+
+    std::vector<detail::MultiTaskScheduler*> active = schedulers();
+    std::vector<detail::MultiTaskScheduler*> created;
+    std::vector<detail::MultiTaskScheduler*> retiring;
+
+    // Retire the most recently added schedulers first.
+    while (active.size() > macrothreads) {
+        retiring.push_back(active.back());
+        retired_.push_back(active.back());
+        active.pop_back();
+    }
+
+    while (active.size() < macrothreads) {
+        if (!retired_.empty()) {
+            active.push_back(retired_.back());
+            retired_.pop_back();
+            active.back()->reactivate();
+        } else {
+            std::uniform_int_distribution<uint64_t> seedDist;
+            generatorMutex.lock();
+            uint64_t seed = seedDist(seedGenerator);
+            generatorMutex.unlock();
+
+            uint32_t index = allSchedulers_.size();
+            auto scheduler = new detail::MultiTaskScheduler(this, index, seed);
+            if (config_.pinThreads) {
+                // Placement is stable, the n-th scheduler always gets the same CPU.
+                scheduler->setCpu(config_.topology->placement(index + 1)[index]);
+            }
+
+            allSchedulers_.push_back(scheduler);
+            created.push_back(scheduler);
+            active.push_back(scheduler);
+        }
+    }
+
+    publish(std::move(active));
+
+    // Retire only after the smaller set is published, so that nobody hands work to a retiring scheduler.
+    for (auto scheduler : retiring) {
+        scheduler->retire();
+    }
+
+    for (auto scheduler : created) {
+        scheduler->start();
+    }
+}
+
+void FiberSystem::publish(std::vector<detail::MultiTaskScheduler*> active) {
+    if (snapshots_.size() <= active.size())
+        snapshots_.resize(active.size() + 1);
+
+    std::unique_ptr<Snapshot>& snapshot = snapshots_[active.size()];
+    if (snapshot == nullptr) {
+        snapshot.reset(new Snapshot);
+
+        // Order the steal victims by distance.
+        if (config_.pinThreads && config_.topologyAwareStealing) {
+            for (auto thief : active) {
+                std::unique_ptr<detail::MultiTaskScheduler::Victims> victims(new detail::MultiTaskScheduler::Victims(RemoteNode));
+                for (auto victim : active) {
+                    if (victim == thief)
+                        continue;
+
+                    // Two schedulers on the same CPU are as close as SMT siblings.
+                    CpuDistance distance = std::max(Topology::distance(*thief->cpu(), *victim->cpu()), SmtSibling);
+                    (*victims)[distance - 1].push_back(victim);
+                }
+
+                victims->erase(std::remove_if(victims->begin(), victims->end(), [] (const auto& tier) {
+                    return tier.empty();
+                }), victims->end());
+
+                snapshot->victims.emplace_back(std::move(victims));
+            }
+        }
+
+        snapshot->schedulers = std::move(active);
+    } else {
+        // Schedulers retire and come back last in, first out, so a size always means the same schedulers.
+        assert(snapshot->schedulers == active);
+    }
+
+    for (size_t i = 0; i < snapshot->victims.size(); ++i) {
+        snapshot->schedulers[i]->setVictims(snapshot->victims[i].get());
+    }
+
+    idleWorkers_->setWorkers(snapshot->schedulers.size());
+    schedulers_.store(&snapshot->schedulers, std::memory_order_release);
+}
+
+void FiberSystem::monitor() {
+    using namespace std::chrono;
+
+    // Check the running tasks twice per time slice, so that a slice overruns by at most a half.
+    const bool preemption = config_.preemption != Preemption::Disabled;
+    const bool handoff = config_.blockingHandoff;
+    const int signal = config_.preemption == Preemption::Signal ? config_.preemptionSignal : 0;
+    microseconds tick = config_.autoScaleInterval;
+    if (preemption)
+        tick = std::min(tick, config_.timeSlice / 2);
+    if (handoff)
+        tick = std::min(tick, config_.blockingHandoffDelay);
+    tick = std::max(tick, microseconds(100));
+
+    // Like Go's sysmon, back off while nothing is running, up to 10ms.
+    const microseconds idleTick = std::max(tick, microseconds(10 * 1000));
+    microseconds wait = tick;
+
+    uint32_t idleSamples = 0;
+    std::vector<detail::MultiTaskScheduler*> checked;
+    auto nextAutoScale = steady_clock::now() + config_.autoScaleInterval;
+    std::unique_lock<std::mutex> lock(monitorMutex_);
+    while (!monitorCondition_.wait_for(lock, wait, [this] () { return monitorStopping_; })) {
+        if (preemption || handoff) {
+            // Retired schedulers still run their pinned tasks, so check every scheduler ever created.
+            {
+                std::lock_guard<std::mutex> resizeLock(resizeMutex_);
+                checked.assign(allSchedulers_.begin(), allSchedulers_.end());
+            }
+
+            bool busy = false;
+            uint64_t now = uv_hrtime_fast();
+            for (auto scheduler : checked) {
+                busy = busy || scheduler->busy();
+                if (preemption)
+                    scheduler->requestPreemption(now, signal);
+                if (handoff)
+                    scheduler->requestHandoff(now);
+            }
+            wait = busy ? tick : std::min(wait * 2, idleTick);
+        }
+
+        if (config_.autoScale && steady_clock::now() >= nextAutoScale) {
+            nextAutoScale = steady_clock::now() + config_.autoScaleInterval;
+            autoScale(idleSamples);
+        }
+    }
+}
+
+void FiberSystem::autoScale(uint32_t& idleSamples) {
+    // Queued tasks per scheduler that trigger growing.
+    const size_t growLoad = 16;
+    // Consecutive idle samples that trigger shrinking.
+    const uint32_t shrinkSamples = 10;
+
+    const auto& active = schedulers();
+    uint32_t size = active.size();
+
+    size_t load = 0;
+    for (auto scheduler : active) {
+        load += scheduler->load();
+    }
+
+    if (idleWorkers_->parked() == 0 && load >= growLoad * size) {
+        idleSamples = 0;
+        if (size < config_.maxMacrothreads)
+            resize(size + 1);
+    } else if (idleWorkers_->parked() > 0) {
+        idleSamples += 1;
+        if (idleSamples >= shrinkSamples && size > std::max(config_.minMacrothreads, 1u)) {
+            idleSamples = 0;
+            resize(size - 1);
+        }
+    } else {
+        idleSamples = 0;
+    }
+}
+
 void FiberSystem::shutdown() {
     shuttingDown_ = true;
 }
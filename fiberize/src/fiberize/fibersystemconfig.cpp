@@ -0,0 +1,36 @@
+#include <fiberize/fibersystemconfig.hpp>
+
+#include <thread>
+
+#include <signal.h>
+
+namespace fiberize {
+
+FiberSystemConfig::FiberSystemConfig()
+    : macrothreads(std::thread::hardware_concurrency())
+    , pinThreads(false)
+    , topologyAwareStealing(true)
+    , stealHalf(true)
+    , autoScale(false)
+    , minMacrothreads(1)
+    , maxMacrothreads(std::thread::hardware_concurrency())
+    , autoScaleInterval(100)
+    , preemption(Preemption::Disabled)
+    , timeSlice(10 * 1000)
+    , preemptionSignal(SIGURG)
+    , overrunThreshold(100 * 1000)
+    , blockingHandoff(false)
+    , blockingHandoffDelay(1000)
+    , preferredStealDelay(100)
+    , preferredStealDepth(16)
+    , wakePolicy(WakePolicy::Local)
+    , wakeLoadLimit(64)
+    , placement(Placement::Local)
+    , sharded(false)
+    , stackPoolLowWatermark(256)
+    , stackPoolHighWatermark(4096)
+    , stackGuardPages(true)
+    , stackProfiling(false)
+    , stackRightSizing(false) {}
+
+} // namespace fiberize
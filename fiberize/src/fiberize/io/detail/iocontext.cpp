@@ -23,9 +23,15 @@ const uint64_t timeInterval = 1000 * 1000 * 10;
 IOContext::IOContext() {
     lastRun = 0;
     uv_loop_init(loop());
+
+    // The wakeup handle is referenced only while waiting, so it doesn't keep the loop alive.
+    uv_async_init(loop(), &wakeup_, [] (uv_async_t*) {});
+    uv_unref(reinterpret_cast<uv_handle_t*>(&wakeup_));
 }
 
 IOContext::~IOContext() {
+    uv_close(reinterpret_cast<uv_handle_t*>(&wakeup_), nullptr);
+    uv_run(loop(), UV_RUN_NOWAIT);
     uv_loop_close(loop());
 }
 
@@ -42,6 +48,17 @@ void IOContext::throttledPoll() {
     }
 }
 
+void IOContext::wait() {
+    lastRun = uv_hrtime_fast();
+    uv_ref(reinterpret_cast<uv_handle_t*>(&wakeup_));
+    uv_run(loop(), UV_RUN_ONCE);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&wakeup_));
+}
+
+void IOContext::wakeup() {
+    uv_async_send(&wakeup_);
+}
+
 uv_loop_t* IOContext::loop() {
     return &loop_;
 }
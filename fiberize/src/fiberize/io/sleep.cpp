@@ -11,7 +11,9 @@ namespace io {
 
 template <>
 void millisleep<Block>(const std::chrono::milliseconds& duration) {
-    std::this_thread::sleep_for(duration);
+    context::blocking([&duration] () {
+        std::this_thread::sleep_for(duration);
+    });
 }
 
 template <>
@@ -5,8 +5,6 @@
  * @copyright 2015 Paweł Nowak
  */
 #include <fiberize/scheduler.hpp>
-#include <thread>
-#include <chrono>
 
 namespace fiberize {
 
@@ -23,25 +21,6 @@ void Scheduler::resetCurrent() {
     current_ = nullptr;
 }
 
-void Scheduler::idle(uint64_t& idleStreak) {
-    using namespace std::literals;
-
-    if (idleStreak <= 16) {
-        // Nothing.
-    } else if (idleStreak <= 64) {
-        // Yield.
-        std::this_thread::yield();
-    } else if (idleStreak <= 64 * 1024) {
-        // Nanosleep.
-        std::this_thread::sleep_for(1ns);
-    } else {
-        // Millisleep.
-        std::this_thread::sleep_for(1ms);
-    }
-
-    idleStreak += 1;
-}
-
 void Scheduler::kill(detail::Task* task, std::unique_lock<Spinlock>&& lock) {
     if (task->refCount == 0) {
         lock.release();
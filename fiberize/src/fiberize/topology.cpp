@@ -0,0 +1,193 @@
+/**
+ * CPU topology discovery.
+ *
+ * @file topology.cpp
+ * @copyright 2015 Paweł Nowak
+ */
+#include <fiberize/topology.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sched.h>
+
+namespace fiberize {
+
+constexpr uint32_t Cpu::unknown;
+
+const std::string sysfsCpu = "/sys/devices/system/cpu/";
+const std::string sysfsNode = "/sys/devices/system/node/";
+
+static bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::getline(file, contents);
+    return true;
+}
+
+static uint32_t readNumber(const std::string& path) {
+    std::string contents;
+    if (!readFile(path, contents))
+        return Cpu::unknown;
+    try {
+        return std::stoul(contents);
+    } catch (...) {
+        return Cpu::unknown;
+    }
+}
+
+/**
+ * Parses the kernel's cpu list format, for example "0-3,8,10-11".
+ */
+static std::vector<uint32_t> parseCpuList(const std::string& list) {
+    std::vector<uint32_t> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        try {
+            size_t dash = range.find('-');
+            if (dash == std::string::npos) {
+                cpus.push_back(std::stoul(range));
+            } else {
+                uint32_t first = std::stoul(range.substr(0, dash));
+                uint32_t last = std::stoul(range.substr(dash + 1));
+                for (uint32_t cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } catch (...) {
+            // Skip malformed ranges.
+        }
+    }
+    return cpus;
+}
+
+/**
+ * Finds the lowest CPU sharing the highest level cache with the given CPU.
+ */
+static uint32_t lastLevelCache(uint32_t cpu) {
+    uint32_t bestLevel = 0;
+    uint32_t cache = Cpu::unknown;
+    for (uint32_t index = 0; ; ++index) {
+        std::string path = sysfsCpu + "cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index) + "/";
+        uint32_t level = readNumber(path + "level");
+        if (level == Cpu::unknown)
+            break;
+
+        std::string shared;
+        if (level > bestLevel && readFile(path + "shared_cpu_list", shared)) {
+            std::vector<uint32_t> cpus = parseCpuList(shared);
+            if (!cpus.empty()) {
+                bestLevel = level;
+                cache = *std::min_element(cpus.begin(), cpus.end());
+            }
+        }
+    }
+    return cache;
+}
+
+Topology::Topology(std::vector<Cpu> cpus) : cpus_(std::move(cpus)) {
+    std::sort(cpus_.begin(), cpus_.end(), [] (const Cpu& a, const Cpu& b) {
+        return a.id < b.id;
+    });
+}
+
+Topology Topology::discover() {
+    std::string online;
+    if (!readFile(sysfsCpu + "online", online))
+        return flat(std::thread::hardware_concurrency());
+
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    bool haveAffinity = sched_getaffinity(0, sizeof(affinity), &affinity) == 0;
+
+    std::vector<Cpu> cpus;
+    for (uint32_t id : parseCpuList(online)) {
+        if (haveAffinity && id < CPU_SETSIZE && !CPU_ISSET(id, &affinity))
+            continue;
+
+        std::string topology = sysfsCpu + "cpu" + std::to_string(id) + "/topology/";
+        Cpu cpu;
+        cpu.id = id;
+        cpu.core = readNumber(topology + "core_id");
+        cpu.package = readNumber(topology + "physical_package_id");
+        cpu.node = Cpu::unknown;
+        cpu.cache = lastLevelCache(id);
+        cpus.push_back(cpu);
+    }
+
+    // Assign the NUMA nodes.
+    std::string possible;
+    if (readFile(sysfsNode + "possible", possible)) {
+        for (uint32_t node : parseCpuList(possible)) {
+            std::string list;
+            if (!readFile(sysfsNode + "node" + std::to_string(node) + "/cpulist", list))
+                continue;
+
+            for (uint32_t id : parseCpuList(list)) {
+                for (Cpu& cpu : cpus) {
+                    if (cpu.id == id)
+                        cpu.node = node;
+                }
+            }
+        }
+    }
+
+    if (cpus.empty())
+        return flat(std::thread::hardware_concurrency());
+
+    return Topology(std::move(cpus));
+}
+
+Topology Topology::flat(uint32_t count) {
+    std::vector<Cpu> cpus;
+    for (uint32_t id = 0; id < std::max(count, 1u); ++id) {
+        cpus.push_back(Cpu{id, Cpu::unknown, Cpu::unknown, Cpu::unknown, Cpu::unknown});
+    }
+    return Topology(std::move(cpus));
+}
+
+CpuDistance Topology::distance(const Cpu& a, const Cpu& b) {
+    if (a.id == b.id)
+        return SameCpu;
+    if (a.core != Cpu::unknown && a.package != Cpu::unknown && a.core == b.core && a.package == b.package)
+        return SmtSibling;
+    if (a.cache != Cpu::unknown && a.cache == b.cache)
+        return SharedCache;
+    if (a.node == b.node || a.node == Cpu::unknown || b.node == Cpu::unknown)
+        return SameNode;
+    return RemoteNode;
+}
+
+std::vector<Cpu> Topology::placement(uint32_t threads) const {
+    // Number the hyperthreads of each core, so that the first hyperthreads of all cores come first.
+    std::vector<std::pair<uint32_t, Cpu>> ranked;
+    for (const Cpu& cpu : cpus_) {
+        uint32_t rank = 0;
+        for (const auto& other : ranked) {
+            if (distance(cpu, other.second) == SmtSibling)
+                rank += 1;
+        }
+        ranked.emplace_back(rank, cpu);
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), [] (const auto& a, const auto& b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        if (a.second.node != b.second.node)
+            return a.second.node < b.second.node;
+        return a.second.cache < b.second.cache;
+    });
+
+    std::vector<Cpu> result;
+    for (uint32_t i = 0; i < threads && !ranked.empty(); ++i) {
+        result.push_back(ranked[i % ranked.size()].second);
+    }
+    return result;
+}
+
+} // namespace fiberize
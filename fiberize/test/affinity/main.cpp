@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace fiberize;
+using namespace std::literals;
+
+const uint count = 20;
+
+std::atomic<uint> finished;
+std::atomic<uint> ready;
+std::atomic<uint> stolen;
+
+Event<void> wake;
+
+TEST(Affinity, ShouldReturnToPreferredScheduler) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.preferredStealDelay = 1h;
+    config.preferredStealDepth = count;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    finished = 0;
+    ready = 0;
+    stolen = 0;
+
+    Scheduler* preferred = fiberSystem.schedulers()[0];
+    fiberSystem.fiber([preferred] () {
+        std::vector<FiberRef> sleepers;
+        for (uint i = 0; i < count; ++i) {
+            sleepers.push_back(context::system()->fiber([preferred] () {
+                if (Scheduler::current() != preferred)
+                    stolen += 1;
+                ready += 1;
+                wake.await();
+                if (Scheduler::current() != preferred)
+                    stolen += 1;
+                finished += 1;
+            }).preferred().run());
+        }
+
+        while (ready < count)
+            context::yield();
+
+        for (FiberRef& sleeper : sleepers) {
+            sleeper.send(wake);
+        }
+    }).pinned(preferred).run_();
+
+    while (finished < count);
+    EXPECT_EQ(0, stolen);
+}
+
+/**
+ * Spawns tasks preferring a scheduler and keeps it busy until the other scheduler runs
+ * the given number of them.
+ */
+void keepPreferredBusy(FiberSystemConfig config, uint expected) {
+    config.macrothreads = 2;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    finished = 0;
+
+    Scheduler* preferred = fiberSystem.schedulers()[0];
+    auto spinner = fiberSystem.future([expected] () {
+        for (uint i = 0; i < count; ++i) {
+            context::system()->fiber([] () {
+                finished += 1;
+            }).preferred().run_();
+        }
+
+        // Don't give the scheduler back until the thieves are done.
+        while (finished < expected);
+        return finished.load();
+    }).pinned(preferred).run();
+
+    EXPECT_EQ(expected, spinner.await().get());
+}
+
+TEST(Affinity, ThievesShouldTakeTasksThatWaitedTooLong) {
+    FiberSystemConfig config;
+    config.preferredStealDelay = 1ms;
+    keepPreferredBusy(config, count);
+}
+
+TEST(Affinity, ThievesShouldTakeTasksAboveDepth) {
+    FiberSystemConfig config;
+    config.preferredStealDelay = 1h;
+    config.preferredStealDepth = 4;
+    keepPreferredBusy(config, count - 4);
+}
+
+TEST(Affinity, LastWakePolicyShouldResumeOnLastScheduler) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.wakePolicy = WakePolicy::Last;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    const uint wakeups = 10;
+    std::atomic<Scheduler*> last(nullptr);
+    std::atomic<uint> moved(0);
+    std::atomic<uint> woken(0);
+
+    FiberRef sleeper = fiberSystem.fiber([&] () {
+        last = Scheduler::current();
+        for (uint i = 0; i < wakeups; ++i) {
+            wake.await();
+            if (Scheduler::current() != last)
+                moved += 1;
+            last = Scheduler::current();
+            woken += 1;
+        }
+    }).run();
+
+    // Without the policy the main thread would resume the sleeper on a random scheduler.
+    for (uint i = 0; i < wakeups; ++i) {
+        std::this_thread::sleep_for(5ms);
+        sleeper.send(wake);
+        while (woken < i + 1);
+    }
+
+    EXPECT_EQ(0, moved);
+}
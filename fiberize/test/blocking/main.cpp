@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace fiberize;
+using namespace std::literals;
+
+FiberSystemConfig blockingConfig(uint macrothreads) {
+    FiberSystemConfig config;
+    config.macrothreads = macrothreads;
+    config.blockingHandoff = true;
+    return config;
+}
+
+TEST(Blocking, ShouldRunOtherTasksDuringBlockingCall) {
+    FiberSystem fiberSystem(blockingConfig(1));
+    fiberSystem.fiberize();
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> finished(false);
+    auto blocked = fiberSystem.future([&started, &finished] () {
+        started = true;
+        context::blocking([] () {
+            std::this_thread::sleep_for(500ms);
+        });
+        finished = true;
+    }).run();
+
+    // Make sure the blocking call occupies the only macrothread.
+    while (!started.load());
+
+    auto other = fiberSystem.future([&finished] () {
+        return finished.load();
+    }).run();
+
+    EXPECT_FALSE(other.await().get());
+    blocked.await();
+    EXPECT_TRUE(finished);
+}
+
+TEST(Blocking, ShouldReturnValuesAndExceptions) {
+    FiberSystem fiberSystem(blockingConfig(2));
+    fiberSystem.fiberize();
+
+    std::vector<FutureRef<int>> refs;
+    for (int i = 0; i < 20; ++i) {
+        refs.push_back(fiberSystem.future([i] () {
+            int value = context::blocking([i] () {
+                std::this_thread::sleep_for(5ms);
+                return i;
+            });
+
+            if (i % 2 == 1) {
+                context::blocking([] () {
+                    std::this_thread::sleep_for(5ms);
+                    throw std::runtime_error("blocking call failed");
+                });
+            }
+            return value;
+        }).run());
+    }
+
+    for (int i = 0; i < 20; ++i) {
+        if (i % 2 == 0) {
+            EXPECT_EQ(i, refs[i].await().get());
+        } else {
+            EXPECT_THROW(refs[i].await().get(), std::runtime_error);
+        }
+    }
+}
+
+TEST(Blocking, ShouldSleepInBlockMode) {
+    FiberSystem fiberSystem(blockingConfig(1));
+    fiberSystem.fiberize();
+
+    auto sleeper = fiberSystem.future([] () {
+        io::sleep<io::Block>(50ms);
+    }).run();
+
+    std::vector<FutureRef<int>> refs;
+    for (int i = 0; i < 100; ++i) {
+        refs.push_back(fiberSystem.future([i] () {
+            context::yield();
+            return i;
+        }).run());
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, refs[i].await().get());
+    }
+    sleeper.await();
+}
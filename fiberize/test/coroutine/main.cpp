@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/io/io.hpp>
+
+using namespace fiberize;
+using namespace std::literals;
+
+uint coroutines = 100000;
+
+Event<int> question;
+
+TEST(Coroutines, ShouldAwaitEvents) {
+    FiberSystem fiberSystem;
+    fiberSystem.fiberize();
+
+    FutureRef<int> ref = fiberSystem.coroutine([] () -> Coroutine<int> {
+        int value = co_await question;
+        co_return value + 1;
+    }).run();
+
+    ref.send(question, 41);
+    EXPECT_EQ(42, ref.await().get());
+}
+
+TEST(Coroutines, ShouldAwaitFutures) {
+    FiberSystem fiberSystem;
+    fiberSystem.fiberize();
+
+    FutureRef<int> ref = fiberSystem.coroutine([&fiberSystem] () -> Coroutine<int> {
+        int sum = 0;
+        for (int i = 0; i < 10; ++i) {
+            FutureRef<int> future = fiberSystem.future([i] () { return i; }).run();
+            Result<int> result = co_await future;
+            sum += result.get();
+        }
+        co_return sum;
+    }).run();
+
+    EXPECT_EQ(45, ref.await().get());
+}
+
+TEST(Coroutines, ShouldAwaitPromises) {
+    FiberSystem fiberSystem;
+    fiberSystem.fiberize();
+
+    Promise<int> promise;
+    std::vector<FutureRef<int>> refs;
+    for (uint i = 0; i < coroutines; ++i) {
+        refs.push_back(fiberSystem.coroutine([&promise, i] () -> Coroutine<int> {
+            int value = co_await promise;
+            co_return value + int(i);
+        }).run());
+    }
+
+    promise.complete(1);
+    for (uint i = 0; i < coroutines; ++i) {
+        EXPECT_EQ(int(i) + 1, refs[i].await().get());
+    }
+}
+
+TEST(Coroutines, ShouldAwaitIO) {
+    FiberSystem fiberSystem;
+    fiberSystem.fiberize();
+
+    FutureRef<void> ref = fiberSystem.coroutine([] () -> Coroutine<void> {
+        Result<void> result = co_await io::sleep<io::Async>(10ms);
+        result.get();
+    }).run();
+
+    ref.await().get();
+}
+
+TEST(Coroutines, ShouldPropagateExceptions) {
+    FiberSystem fiberSystem;
+    fiberSystem.fiberize();
+
+    FutureRef<int> ref = fiberSystem.coroutine([] () -> Coroutine<int> {
+        co_await io::sleep<io::Async>(1ms);
+        throw std::runtime_error("failed");
+    }).run();
+
+    EXPECT_THROW(ref.await().get(), std::runtime_error);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <vector>
+
+using namespace fiberize;
+
+std::mutex orderMutex;
+std::vector<uint> order;
+std::atomic<uint> finished;
+std::atomic<uint> ready;
+
+void record(uint index) {
+    std::lock_guard<std::mutex> lock(orderMutex);
+    order.push_back(index);
+    finished += 1;
+}
+
+Event<void> wake;
+
+TEST(Deadline, ShouldRunEarlierDeadlinesFirst) {
+    FiberSystem fiberSystem(1);
+    fiberSystem.fiberize();
+
+    const uint count = 100;
+    order.clear();
+    finished = 0;
+
+    std::vector<uint> indices(count);
+    for (uint i = 0; i < count; ++i)
+        indices[i] = i;
+    std::shuffle(indices.begin(), indices.end(), std::mt19937(42));
+
+    // Spawn everything from a single task, so they all wait in the queues of the only macrothread.
+    fiberSystem.fiber([indices] () {
+        auto now = std::chrono::steady_clock::now();
+        for (uint index : indices) {
+            context::system()->fiber([index] () {
+                record(index);
+            }).deadline(now + std::chrono::milliseconds(index)).run_();
+        }
+    }).run_();
+
+    while (finished < count);
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    ASSERT_EQ(count, order.size());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
+
+TEST(Deadline, ShouldWakeReceiversByEventDeadline) {
+    FiberSystem fiberSystem(1);
+    fiberSystem.fiberize();
+
+    const uint count = 100;
+    order.clear();
+    finished = 0;
+    ready = 0;
+
+    fiberSystem.fiber([] () {
+        std::vector<FiberRef> receivers;
+        for (uint i = 0; i < count; ++i) {
+            receivers.push_back(context::system()->fiber([i] () {
+                ready += 1;
+                wake.await();
+                record(i);
+            }).run());
+        }
+
+        // Let all receivers suspend.
+        while (ready < count)
+            context::yield();
+
+        // Send in the reverse order of the deadlines.
+        auto now = std::chrono::steady_clock::now();
+        for (uint i = count; i-- > 0;) {
+            receivers[i].sendWithDeadline(now + std::chrono::milliseconds(i), wake);
+        }
+    }).run_();
+
+    while (finished < count);
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    ASSERT_EQ(count, order.size());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
+
+TEST(Deadline, ShouldMoveQueuedReceiversByEventDeadline) {
+    FiberSystem fiberSystem(1);
+    fiberSystem.fiberize();
+
+    const uint count = 100;
+    const uint first = 45;
+    const uint urgent = 10;
+    order.clear();
+    finished = 0;
+    ready = 0;
+
+    fiberSystem.fiber([] () {
+        std::vector<FiberRef> receivers;
+        for (uint i = 0; i < count; ++i) {
+            receivers.push_back(context::system()->fiber([i] () {
+                ready += 1;
+                wake.await();
+                record(i);
+            }).run());
+        }
+
+        // Let all receivers suspend.
+        while (ready < count)
+            context::yield();
+
+        // Queue every receiver without a deadline first.
+        for (uint i = 0; i < count; ++i) {
+            receivers[i].send(wake);
+        }
+
+        // Receivers in the middle of the queue become urgent, the later ones sooner.
+        auto now = std::chrono::steady_clock::now();
+        for (uint i = first; i < first + urgent; ++i) {
+            receivers[i].sendWithDeadline(now + std::chrono::milliseconds(first + urgent - i), wake);
+        }
+    }).run_();
+
+    while (finished < count);
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    ASSERT_EQ(count, order.size());
+    for (uint i = 0; i < urgent; ++i) {
+        EXPECT_EQ(first + urgent - 1 - i, order[i]);
+    }
+}
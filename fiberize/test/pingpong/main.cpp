@@ -1,10 +1,18 @@
 #include <fiberize/fiberize.hpp>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <thread>
+
 using namespace fiberize;
 
 uint32_t messages = 1000000;
 
+/**
+ * Messages exchanged by the tests checking behaviour rather than throughput.
+ */
+uint32_t exchanges = 10000;
+
 Event<FiberRef> hello;
 Event<void> ack;
 
@@ -46,3 +54,91 @@ TEST(PingPong, PingPong) {
     bobRef.await();
     aliceRef.await();
 }
+
+void switchingAlice(FiberRef peer) {
+    using namespace context;
+
+    peer.sendAndSwitch(hello, self());
+    ack.await();
+
+    for (uint32_t sent = 0; sent < exchanges; ++sent) {
+        peer.sendAndSwitch(ping);
+        pong.await();
+    }
+}
+
+void switchingBob() {
+    FiberRef peer = hello.await();
+    peer.sendAndSwitch(ack);
+
+    for (uint32_t received = 0; received < exchanges; ++received) {
+        ping.await();
+        peer.sendAndSwitch(pong);
+    }
+}
+
+TEST(PingPong, SendAndSwitch) {
+    for (uint32_t macrothreads : {1u, 4u}) {
+        FiberSystem system(macrothreads);
+        FiberRef self = system.fiberize();
+
+        auto bobRef = system.future(switchingBob).run();
+        auto aliceRef = system.future(switchingAlice).run(bobRef);
+
+        bobRef.await();
+        aliceRef.await();
+    }
+}
+
+struct Echo {
+    HandlerRef handleHello;
+
+    void operator () () {
+        handleHello = hello.bind([] (const FiberRef& sender) {
+            sender.send(pong);
+        });
+    }
+};
+
+TEST(PingPong, NonBlockingHandlers) {
+    for (uint32_t macrothreads : {1u, 4u}) {
+        FiberSystem system(macrothreads);
+        FiberRef self = system.fiberize();
+
+        FiberRef echo = system.actor(Echo{}).nonBlockingHandlers().run();
+        auto aliceRef = system.future([echo] () {
+            for (uint32_t sent = 0; sent < exchanges; ++sent) {
+                echo.send(hello, context::self());
+                pong.await();
+            }
+        }).run();
+
+        aliceRef.await();
+        echo.kill();
+    }
+}
+
+struct Sleeper {
+    HandlerRef handlePing;
+
+    void operator () () {
+        handlePing = ping.bind([] () {
+            context::yield();
+        });
+    }
+};
+
+TEST(PingPongDeathTest, SuspendingNonBlockingHandlersShouldAbort) {
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_DEATH({
+        FiberSystem system(1);
+        system.fiberize();
+
+        // Pings processed while the actor starts run on its own stack, keep sending until one runs inline.
+        FiberRef sleeper = system.actor(Sleeper{}).named("sleeper").nonBlockingHandlers().run();
+        for (;;) {
+            sleeper.send(ping);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }, "task .*sleeper suspended in a non-blocking handler");
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+using namespace fiberize;
+
+const uint32_t macrothreads = 4;
+const uint tasks = 400;
+
+std::atomic<uint> finished;
+
+/**
+ * Occupies every macrothread, so nothing is stolen, spawns tasks from the main thread
+ * and returns the number of tasks queued on each macrothread.
+ */
+std::vector<size_t> spawn(Placement placement) {
+    finished = 0;
+
+    FiberSystemConfig config;
+    config.macrothreads = macrothreads;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    std::atomic<uint> started(0);
+    std::atomic<bool> released(false);
+    for (auto scheduler : fiberSystem.schedulers()) {
+        fiberSystem.fiber([&started, &released] () {
+            started += 1;
+            while (!released.load());
+            finished += 1;
+        }).pinned(scheduler).run_();
+    }
+    while (started < macrothreads);
+    for (uint i = 0; i < tasks; ++i) {
+        fiberSystem.fiber([] () {
+            finished += 1;
+        }).placement(placement).run_();
+    }
+
+    std::vector<size_t> loads;
+    for (auto scheduler : fiberSystem.schedulers()) {
+        loads.push_back(scheduler->load());
+    }
+
+    released = true;
+    while (finished < tasks + macrothreads);
+    return loads;
+}
+
+TEST(Placement, RoundRobinShouldSpreadEvenly) {
+    auto loads = spawn(Placement::RoundRobin);
+    for (size_t load : loads) {
+        EXPECT_EQ(tasks / macrothreads, load);
+    }
+}
+
+TEST(Placement, LeastLoadedShouldKeepLoadsClose) {
+    auto loads = spawn(Placement::LeastLoaded);
+    EXPECT_EQ(tasks, std::accumulate(loads.begin(), loads.end(), size_t(0)));
+    EXPECT_LE(*std::max_element(loads.begin(), loads.end()) - *std::min_element(loads.begin(), loads.end()), 10);
+}
+
+TEST(Placement, HashedShouldUseEveryMacrothread) {
+    auto loads = spawn(Placement::Hashed);
+    EXPECT_EQ(tasks, std::accumulate(loads.begin(), loads.end(), size_t(0)));
+    for (size_t load : loads) {
+        EXPECT_GT(load, 0);
+    }
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+using namespace fiberize;
+
+const uint tasks = 100;
+
+std::atomic<uint> finished;
+std::atomic<uint> misplaced;
+
+/**
+ * Whether the current scheduler is one of the given ones.
+ */
+bool runningOn(const std::vector<detail::MultiTaskScheduler*>& schedulers) {
+    return std::find(schedulers.begin(), schedulers.end(), Scheduler::current()) != schedulers.end();
+}
+
+FiberSystemConfig poolsConfig() {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.pools = {{"io", 2}};
+    return config;
+}
+
+TEST(Pools, TasksShouldRunInTheirPool) {
+    FiberSystem fiberSystem(poolsConfig());
+    fiberSystem.fiberize();
+
+    finished = 0;
+    misplaced = 0;
+
+    const auto& io = fiberSystem.schedulers("io");
+    const auto& defaults = fiberSystem.schedulers();
+    for (uint i = 0; i < tasks; ++i) {
+        fiberSystem.fiber([&io, &defaults] () {
+            if (!runningOn(io))
+                misplaced += 1;
+
+            // Children go to the default pool, unless they ask otherwise.
+            context::system()->fiber([&defaults] () {
+                if (!runningOn(defaults))
+                    misplaced += 1;
+                finished += 1;
+            }).run_();
+
+            context::yield();
+            if (!runningOn(io))
+                misplaced += 1;
+            finished += 1;
+        }).inPool("io").run_();
+    }
+
+    while (finished < 2 * tasks);
+    EXPECT_EQ(0, misplaced);
+}
+
+TEST(Pools, BusyDefaultPoolShouldNotDelayOtherPools) {
+    FiberSystem fiberSystem(poolsConfig());
+    fiberSystem.fiberize();
+
+    finished = 0;
+
+    // Occupy every macrothread of the default pool until the io tasks are done.
+    std::atomic<uint> started(0);
+    for (auto scheduler : fiberSystem.schedulers()) {
+        fiberSystem.fiber([&started] () {
+            started += 1;
+            while (finished < tasks);
+        }).pinned(scheduler).run_();
+    }
+    while (started < fiberSystem.schedulers().size());
+
+    for (uint i = 0; i < tasks; ++i) {
+        fiberSystem.fiber([] () {
+            finished += 1;
+        }).inPool("io").run_();
+    }
+
+    while (finished < tasks);
+}
+
+TEST(Pools, ShouldRejectUnknownPools) {
+    FiberSystem fiberSystem(poolsConfig());
+    fiberSystem.fiberize();
+
+    EXPECT_THROW(fiberSystem.fiber([] () {}).inPool("compute").run_(), UnknownPool);
+    EXPECT_THROW(fiberSystem.schedulers("compute"), UnknownPool);
+}
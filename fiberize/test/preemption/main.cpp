@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <atomic>
+#include <chrono>
+
+using namespace fiberize;
+using namespace std::literals;
+
+/**
+ * Runs a spinning task and the task it waits for on a single macrothread.
+ */
+void spinUntilReleased(Preemption preemption) {
+    FiberSystemConfig config;
+    config.macrothreads = 1;
+    config.preemption = preemption;
+    config.timeSlice = 1ms;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> released(false);
+    auto spinner = fiberSystem.future([&started, &released] () {
+        started = true;
+        while (!released.load())
+            context::checkpoint();
+    }).run();
+
+    // Make sure the spinner occupies the only macrothread before the releaser is scheduled.
+    while (!started.load());
+    auto releaser = fiberSystem.future([&released] () {
+        released = true;
+    }).run();
+
+    releaser.await();
+    spinner.await();
+}
+
+TEST(Preemption, FlagShouldInterruptSpinningTask) {
+    spinUntilReleased(Preemption::Flag);
+}
+
+TEST(Preemption, SignalShouldInterruptSpinningTask) {
+    spinUntilReleased(Preemption::Signal);
+}
+
+TEST(Preemption, ShouldInterruptSpinningTaskOnRetiredScheduler) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.preemption = Preemption::Flag;
+    config.timeSlice = 1ms;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    auto retired = fiberSystem.schedulers()[1];
+    fiberSystem.resize(1);
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> released(false);
+    auto spinner = fiberSystem.future([&started, &released] () {
+        started = true;
+        while (!released.load())
+            context::checkpoint();
+    }).pinned(retired).run();
+
+    while (!started.load());
+    auto releaser = fiberSystem.future([&released] () {
+        released = true;
+    }).pinned(retired).run();
+
+    releaser.await();
+    spinner.await();
+}
+
+TEST(Preemption, ShouldReportOverruns) {
+    std::atomic<uint> overruns(0);
+
+    FiberSystemConfig config;
+    config.macrothreads = 1;
+    config.preemption = Preemption::Disabled;
+    config.overrunThreshold = 1ms;
+    config.overrunHandler = [&overruns] (const Path&, std::chrono::nanoseconds time) {
+        EXPECT_GE(time, 1ms);
+        overruns += 1;
+    };
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    fiberSystem.future([] () {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < 5ms);
+        context::yield();
+    }).run().await();
+
+    EXPECT_EQ(1, overruns);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace fiberize;
+
+std::mutex orderMutex;
+std::vector<Priority> order;
+std::atomic<uint> finished;
+
+void record(Priority priority) {
+    std::lock_guard<std::mutex> lock(orderMutex);
+    order.push_back(priority);
+    finished += 1;
+}
+
+/**
+ * Spawns the given numbers of tasks of each class from a single task, so they all wait
+ * in the queues of the only macrothread, and returns the order in which they ran.
+ */
+std::vector<Priority> run(uint critical, uint normal, uint background) {
+    FiberSystem fiberSystem(1);
+    fiberSystem.fiberize();
+
+    order.clear();
+    finished = 0;
+
+    fiberSystem.fiber([=] () {
+        auto spawn = [] (Priority priority, uint count) {
+            for (uint i = 0; i < count; ++i) {
+                context::system()->fiber([priority] () {
+                    record(priority);
+                }).priority(priority).run_();
+            }
+        };
+
+        spawn(Priority::Background, background);
+        spawn(Priority::Normal, normal);
+        spawn(Priority::Critical, critical);
+    }).run_();
+
+    while (finished < critical + normal + background);
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    return order;
+}
+
+TEST(Priority, ShouldRunHigherClassesFirst) {
+    auto result = run(10, 10, 10);
+    ASSERT_EQ(30, result.size());
+    EXPECT_TRUE(std::is_sorted(result.begin(), result.end()));
+}
+
+TEST(Priority, ShouldNotStarveLowerClasses) {
+    auto result = run(1000, 100, 10);
+    ASSERT_EQ(1110, result.size());
+
+    // Normal and background tasks run before all critical ones are done.
+    auto lastCritical = std::find(result.rbegin(), result.rend(), Priority::Critical).base();
+    EXPECT_LT(std::find(result.begin(), result.end(), Priority::Normal), lastCritical);
+    EXPECT_LT(std::find(result.begin(), result.end(), Priority::Background), lastCritical);
+}
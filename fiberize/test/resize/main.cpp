@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/multitaskscheduler.hpp>
+
+#include <chrono>
+#include <thread>
+
+using namespace fiberize;
+using namespace std::literals;
+
+uint futures = 10000;
+uint pings = 1000;
+
+Event<FiberRef> ping;
+Event<void> pong;
+
+struct Echo {
+    HandlerRef handlePing;
+
+    void operator () () {
+        handlePing = ping.bind([] (const FiberRef& sender) {
+            sender.send(pong);
+        });
+    }
+};
+
+TEST(Resize, ShouldRunTasksWhileResizing) {
+    FiberSystem fiberSystem(4);
+    fiberSystem.fiberize();
+
+    auto id = fiberSystem.future([] (auto x) {
+        context::yield();
+        return x;
+    });
+
+    for (uint32_t macrothreads : {1u, 3u, 2u, 4u, 1u}) {
+        std::vector<FutureRef<uint>> refs;
+        for (uint i = 0; i < futures; ++i) {
+            refs.push_back(id.copy().run(i));
+        }
+
+        fiberSystem.resize(macrothreads);
+        EXPECT_EQ(macrothreads, fiberSystem.schedulers().size());
+
+        for (uint i = 0; i < futures; ++i) {
+            EXPECT_EQ(i, refs[i].await().get());
+        }
+    }
+}
+
+TEST(Resize, ShouldRunPinnedTasksOnRetiredSchedulers) {
+    FiberSystem fiberSystem(2);
+    FiberRef self = fiberSystem.fiberize();
+
+    auto retiring = fiberSystem.schedulers()[1];
+    FiberRef echo = fiberSystem.actor(Echo{}).pinned(retiring).run();
+    fiberSystem.resize(1);
+
+    for (uint i = 0; i < pings; ++i) {
+        echo.send(ping, self);
+        pong.await();
+    }
+
+    // Reactivation brings the same scheduler back.
+    fiberSystem.resize(2);
+    EXPECT_EQ(retiring, fiberSystem.schedulers()[1]);
+    echo.kill();
+}
+
+TEST(Resize, ShouldShrinkWhenIdle) {
+    FiberSystemConfig config;
+    config.macrothreads = 4;
+    config.autoScale = true;
+    config.minMacrothreads = 2;
+    config.maxMacrothreads = 4;
+    config.autoScaleInterval = 5ms;
+
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (fiberSystem.schedulers().size() > 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(2, fiberSystem.schedulers().size());
+}
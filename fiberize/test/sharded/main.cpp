@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace fiberize;
+
+const uint tasks = 50;
+const uint messages = 1000;
+
+std::atomic<uint> finished;
+std::atomic<uint> misplaced;
+
+Event<uint> ping;
+
+FiberSystemConfig shardedConfig() {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.sharded = true;
+    return config;
+}
+
+TEST(Sharded, TasksShouldStayOnTheirShard) {
+    FiberSystem fiberSystem(shardedConfig());
+    fiberSystem.fiberize();
+
+    finished = 0;
+    misplaced = 0;
+
+    for (uint shard = 0; shard < fiberSystem.shards(); ++shard) {
+        Scheduler* expected = fiberSystem.shard(shard);
+        for (uint i = 0; i < tasks; ++i) {
+            fiberSystem.fiber([expected] () {
+                // Children inherit the shard, even if they don't ask for it.
+                context::system()->fiber([expected] () {
+                    for (uint j = 0; j < 10; ++j) {
+                        context::yield();
+                        if (Scheduler::current() != expected)
+                            misplaced += 1;
+                    }
+                    finished += 1;
+                }).run_();
+
+                for (uint j = 0; j < 10; ++j) {
+                    context::yield();
+                    if (Scheduler::current() != expected)
+                        misplaced += 1;
+                }
+                finished += 1;
+            }).onShard(shard).run_();
+        }
+    }
+
+    while (finished < 2 * tasks * fiberSystem.shards());
+    EXPECT_EQ(0, misplaced);
+}
+
+TEST(Sharded, CrossShardSendsShouldBeDelivered) {
+    FiberSystem fiberSystem(shardedConfig());
+    fiberSystem.fiberize();
+
+    finished = 0;
+    misplaced = 0;
+
+    Scheduler* receiverShard = fiberSystem.shard(0);
+    std::atomic<uint> sum(0);
+    FiberRef receiver = fiberSystem.fiber([&sum, receiverShard] () {
+        for (uint i = 0; i < messages; ++i) {
+            sum += ping.await();
+            if (Scheduler::current() != receiverShard)
+                misplaced += 1;
+        }
+        finished += 1;
+    }).onShard(0).run();
+
+    fiberSystem.fiber([receiver] () mutable {
+        for (uint i = 0; i < messages; ++i) {
+            receiver.send(ping, 1);
+            if (i % 16 == 0)
+                context::yield();
+        }
+    }).onShard(1).run_();
+
+    while (finished < 1);
+    EXPECT_EQ(messages, sum);
+    EXPECT_EQ(0, misplaced);
+}
+
+TEST(Sharded, KeysShouldMapToStableShards) {
+    FiberSystem fiberSystem(shardedConfig());
+    fiberSystem.fiberize();
+
+    std::vector<bool> used(fiberSystem.shards(), false);
+    for (uint i = 0; i < 100; ++i) {
+        std::string key = "key" + std::to_string(i);
+        uint32_t shard = fiberSystem.shardOf(key);
+        ASSERT_LT(shard, fiberSystem.shards());
+        EXPECT_EQ(shard, fiberSystem.shardOf(key));
+        used[shard] = true;
+    }
+    for (bool shard : used) {
+        EXPECT_TRUE(shard);
+    }
+
+    EXPECT_THROW(fiberSystem.fiber([] () {}).onShard(fiberSystem.shards()).run_(), std::out_of_range);
+}
+
+TEST(Sharded, ShouldRejectResize) {
+    FiberSystem fiberSystem(shardedConfig());
+    fiberSystem.fiberize();
+
+    EXPECT_THROW(fiberSystem.resize(4), ShardedResize);
+    EXPECT_EQ(2, fiberSystem.shards());
+}
@@ -0,0 +1,62 @@
+#include <fiberize/detail/spscring.hpp>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace fiberize::detail;
+
+uint64_t values = 1000000;
+
+TEST(SpscRing, IsFifo) {
+    SpscRing<uint64_t> ring(128);
+    for (uint64_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(ring.push(i));
+    }
+
+    uint64_t value;
+    for (uint64_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(ring.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(ring.pop(value));
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(SpscRing, RejectsPushesWhenFull) {
+    SpscRing<uint64_t> ring(4);
+    for (uint64_t i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.push(i));
+    }
+    EXPECT_FALSE(ring.push(4));
+
+    uint64_t value;
+    ASSERT_TRUE(ring.pop(value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(ring.push(4));
+}
+
+TEST(SpscRing, DeliversEveryValueInOrderAcrossThreads) {
+    SpscRing<uint64_t> ring(64);
+
+    std::thread producer([&] () {
+        for (uint64_t i = 0; i < values; ++i) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    uint64_t value;
+    while (expected < values) {
+        if (ring.pop(value)) {
+            ASSERT_EQ(expected, value);
+            expected += 1;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+    EXPECT_TRUE(ring.empty());
+}
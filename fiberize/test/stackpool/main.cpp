@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+#include <fiberize/detail/stackpool.hpp>
+#include <fiberize/detail/stackprofile.hpp>
+#include <fiberize/detail/task.hpp>
+
+#include <atomic>
+#include <limits>
+#include <vector>
+
+using namespace fiberize;
+using namespace fiberize::detail;
+
+const uint sleepers = 300;
+
+Event<void> wake;
+
+/**
+ * Creates a context on a fresh stack, with the whole stack touched.
+ */
+UnownedContext* touchedContext(StackPool& pool) {
+    UnownedContext* context = new UnownedContext;
+    context->stack = pool.allocate(StackPool::sizeClass(0));
+    context->sizeClass = StackPool::sizeClass(0);
+    context->released = false;
+    char* bottom = static_cast<char*>(context->stack.sp) - context->stack.size;
+    std::fill(bottom, static_cast<char*>(context->stack.sp), 1);
+    context->context = static_cast<char*>(context->stack.sp) - 64;
+    return context;
+}
+
+TEST(StackPool, ShouldRespectWatermarks) {
+    StackPool pool(2, 2, 4, true, false);
+
+    std::vector<UnownedContext*> contexts;
+    for (uint i = 0; i < 6; ++i) {
+        contexts.push_back(touchedContext(pool));
+    }
+    EXPECT_EQ(6, pool.stats().allocated);
+
+    pool.give(0, contexts.data(), contexts.size());
+    EXPECT_EQ(4, pool.stats().allocated);
+    EXPECT_EQ(4, pool.stats().pooled);
+    EXPECT_EQ(2, pool.stats().released);
+
+    // Other shards are visited when the own one is empty.
+    UnownedContext* taken[8];
+    EXPECT_EQ(3, pool.take(1, StackPool::sizeClass(0), taken, 3));
+    EXPECT_EQ(1, pool.stats().pooled);
+
+    // Released stacks are usable again.
+    for (uint i = 0; i < 3; ++i) {
+        char* bottom = static_cast<char*>(taken[i]->stack.sp) - taken[i]->stack.size;
+        bottom[0] = 2;
+        EXPECT_FALSE(taken[i]->released);
+    }
+    pool.give(1, taken, 3);
+    EXPECT_EQ(4, pool.stats().pooled);
+}
+
+TEST(StackPool, SystemShouldTrimIdleStacks) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.stackPoolLowWatermark = 0;
+    config.stackPoolHighWatermark = 16;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    std::atomic<uint> ready(0);
+    std::atomic<uint> finished(0);
+    std::vector<FiberRef> fibers;
+    for (uint i = 0; i < sleepers; ++i) {
+        fibers.push_back(fiberSystem.fiber([&ready, &finished] () {
+            ready += 1;
+            wake.await();
+            finished += 1;
+        }).run());
+    }
+
+    while (ready < sleepers);
+    EXPECT_GE(fiberSystem.stackPool().stats().allocated, sleepers);
+
+    for (FiberRef& fiber : fibers) {
+        fiber.send(wake);
+    }
+    while (finished < sleepers);
+
+    // The schedulers keep a few stacks each, the rest is released or unmapped.
+    StackPool::Stats stats = fiberSystem.stackPool().stats();
+    EXPECT_LT(stats.allocated, sleepers / 2);
+    EXPECT_LE(stats.pooled, 16);
+    EXPECT_EQ(stats.pooled, stats.released);
+}
+
+TEST(StackPool, SizesShouldMapToClasses) {
+    EXPECT_EQ(0, StackPool::sizeClass(1));
+    EXPECT_EQ(0, StackPool::sizeClass(16 * 1024));
+    EXPECT_EQ(1, StackPool::sizeClass(16 * 1024 + 1));
+    EXPECT_EQ(6, StackPool::sizeClass(1024 * 1024));
+    EXPECT_EQ(StackPool::sizeClasses - 1, StackPool::sizeClass(1024 * 1024 * 1024));
+    EXPECT_GE(StackPool::classSize(StackPool::sizeClass(0)), boost::context::stack_traits::default_size());
+}
+
+/**
+ * Uses about the given amount of stack.
+ */
+uint64_t useStack(size_t bytes) {
+    volatile char buffer[4096];
+    buffer[0] = 1;
+    if (bytes <= sizeof(buffer))
+        return buffer[0];
+
+    // Use the buffer after the call, so the recursion can't become a loop.
+    buffer[1] = useStack(bytes - sizeof(buffer));
+    return buffer[0] + buffer[1];
+}
+
+TEST(StackPool, TasksShouldGetTheirStackSize) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    const size_t small = 16 * 1024;
+    const size_t large = 1024 * 1024;
+
+    std::atomic<uint> ready(0);
+    std::vector<FiberRef> fibers;
+    for (uint i = 0; i < sleepers; ++i) {
+        fibers.push_back(fiberSystem.fiber([&ready] () {
+            ready += 1;
+            wake.await();
+        }).stackSize(small).run());
+    }
+    while (ready < sleepers);
+    EXPECT_GE(fiberSystem.stackPool().stats(StackPool::sizeClass(small)).allocated, sleepers);
+    for (FiberRef& fiber : fibers) {
+        fiber.send(wake);
+    }
+
+    // This would overflow the default stack.
+    auto deep = fiberSystem.future([large] () {
+        return useStack(large / 2);
+    }).stackSize(large).run();
+    EXPECT_LT(0, deep.await().get());
+}
+
+TEST(StackPool, ProfilingShouldMeasureAndRightSizeStacks) {
+    FiberSystemConfig config;
+    config.macrothreads = 2;
+    config.stackProfiling = true;
+    config.stackRightSizing = true;
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    const size_t deepUse = 64 * 1024;
+    const uint runs = StackProfile::minSamples;
+    for (uint i = 0; i < runs; ++i) {
+        fiberSystem.future([] () { return uint64_t(1); }).named("shallow").run().await();
+        fiberSystem.future([deepUse] () {
+            return useStack(deepUse);
+        }).named("deep").stackSize(256 * 1024).run().await();
+    }
+
+    auto usage = fiberSystem.stackProfile().usage();
+    EXPECT_EQ(runs, usage["shallow"].samples);
+    EXPECT_EQ(runs, usage["deep"].samples);
+    EXPECT_GE(usage["deep"].peak, deepUse);
+    EXPECT_LT(usage["deep"].peak, 256 * 1024);
+    EXPECT_LT(usage["shallow"].peak, 16 * 1024);
+
+    // Enough samples were taken, shallow tasks get a smaller stack now.
+    size_t stackSize = fiberSystem.future([] () {
+        return Scheduler::current()->currentTask()->stack.size;
+    }).named("shallow").run().await().get();
+    EXPECT_LT(stackSize, boost::context::stack_traits::default_size());
+}
+
+/**
+ * Deeper than any stack, read at runtime so that the recursion is not provably infinite.
+ */
+volatile uint64_t overflowLimit = std::numeric_limits<uint64_t>::max();
+
+/**
+ * Recurses until the stack runs out.
+ */
+uint64_t overflow(uint64_t depth) {
+    if (depth == overflowLimit)
+        return depth;
+
+    volatile char buffer[1024];
+    buffer[0] = depth;
+    buffer[1] = overflow(depth + 1);
+    return buffer[0] + buffer[1];
+}
+
+TEST(StackPoolDeathTest, OverflowShouldBeReported) {
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_DEATH({
+        FiberSystemConfig config;
+        config.macrothreads = 1;
+        config.stackGuardPages = true;
+        FiberSystem fiberSystem(config);
+        fiberSystem.fiberize();
+
+        auto future = fiberSystem.future([] () {
+            return overflow(0);
+        }).named("deep").stackSize(16 * 1024).run();
+        future.await();
+    }, "stack overflow in task .*deep, stack size 16384 bytes");
+}
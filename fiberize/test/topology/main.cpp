@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <fiberize/fiberize.hpp>
+
+#include <set>
+
+using namespace fiberize;
+
+uint futures = 100000;
+
+/**
+ * Two NUMA nodes, each with two cores sharing a cache, each core with two hyperthreads.
+ * Hyperthreads are numbered like on Linux: cpu n and n + 4 are siblings.
+ */
+Topology twoNodes() {
+    std::vector<Cpu> cpus;
+    for (uint32_t id = 0; id < 8; ++id) {
+        uint32_t core = id % 4;
+        uint32_t node = core / 2;
+        cpus.push_back(Cpu{id, core, node, node, node * 2});
+    }
+    return Topology(cpus);
+}
+
+TEST(Topology, ShouldMeasureDistance) {
+    Topology topology = twoNodes();
+    auto cpu = [&] (uint32_t id) { return topology.cpus()[id]; };
+
+    EXPECT_EQ(SameCpu, Topology::distance(cpu(0), cpu(0)));
+    EXPECT_EQ(SmtSibling, Topology::distance(cpu(0), cpu(4)));
+    EXPECT_EQ(SharedCache, Topology::distance(cpu(0), cpu(1)));
+    EXPECT_EQ(RemoteNode, Topology::distance(cpu(0), cpu(2)));
+    EXPECT_EQ(RemoteNode, Topology::distance(cpu(5), cpu(3)));
+}
+
+TEST(Topology, ShouldSpreadOverCoresFirst) {
+    Topology topology = twoNodes();
+
+    std::set<uint32_t> cores;
+    for (const Cpu& cpu : topology.placement(4)) {
+        cores.insert(cpu.core);
+    }
+    EXPECT_EQ(4, cores.size());
+
+    std::set<uint32_t> ids;
+    for (const Cpu& cpu : topology.placement(8)) {
+        ids.insert(cpu.id);
+    }
+    EXPECT_EQ(8, ids.size());
+
+    EXPECT_EQ(12, topology.placement(12).size());
+}
+
+TEST(Topology, ShouldTreatFlatCpusAsOneNode) {
+    Topology topology = Topology::flat(4);
+    ASSERT_EQ(4, topology.cpus().size());
+    EXPECT_EQ(SameNode, Topology::distance(topology.cpus()[0], topology.cpus()[3]));
+}
+
+TEST(Topology, ShouldDiscoverSomeCpus) {
+    EXPECT_FALSE(Topology::discover().cpus().empty());
+}
+
+TEST(Topology, ShouldRunPinnedSchedulers) {
+    FiberSystemConfig config;
+    config.macrothreads = 4;
+    config.pinThreads = true;
+    config.topology = Topology::discover();
+
+    FiberSystem fiberSystem(config);
+    fiberSystem.fiberize();
+
+    auto id = fiberSystem.future([] (auto x) {
+        return x;
+    });
+
+    std::vector<FutureRef<uint>> refs;
+    for (uint i = 0; i < futures; ++i) {
+        refs.push_back(id.copy().run(i));
+    }
+    for (uint i = 0; i < futures; ++i) {
+        EXPECT_EQ(i, refs[i].await().get());
+    }
+}
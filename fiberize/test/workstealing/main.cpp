@@ -0,0 +1,93 @@
+#include <fiberize/detail/workstealingdeque.hpp>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace fiberize::detail;
+
+uint64_t values = 1000000;
+uint32_t thieves = 3;
+
+TEST(WorkStealingDeque, OwnerIsLifo) {
+    WorkStealingDeque<uint64_t> deque(2);
+    for (uint64_t i = 0; i < 100; ++i) {
+        deque.push(i);
+    }
+
+    uint64_t value;
+    for (uint64_t i = 100; i > 0; --i) {
+        ASSERT_TRUE(deque.pop(value));
+        EXPECT_EQ(i - 1, value);
+    }
+    EXPECT_FALSE(deque.pop(value));
+}
+
+TEST(WorkStealingDeque, ThievesAreFifo) {
+    WorkStealingDeque<uint64_t> deque(2);
+    for (uint64_t i = 0; i < 100; ++i) {
+        deque.push(i);
+    }
+
+    uint64_t value;
+    for (uint64_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(deque.steal(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(deque.steal(value));
+}
+
+TEST(WorkStealingDeque, StealsHalf) {
+    WorkStealingDeque<uint64_t> deque;
+    for (uint64_t i = 0; i < 101; ++i) {
+        deque.push(i);
+    }
+
+    uint64_t stolen[64];
+    ASSERT_EQ(51, deque.stealHalf(stolen, 64));
+    for (uint64_t i = 0; i < 51; ++i) {
+        EXPECT_EQ(i, stolen[i]);
+    }
+    EXPECT_EQ(50, deque.size());
+    EXPECT_EQ(10, deque.stealHalf(stolen, 10));
+    EXPECT_EQ(40, deque.size());
+}
+
+TEST(WorkStealingDeque, EveryValueIsTakenOnce) {
+    WorkStealingDeque<uint64_t> deque;
+    std::vector<uint8_t> taken(values, 0);
+    std::atomic<bool> done(false);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thieves; ++i) {
+        threads.emplace_back([&] () {
+            uint64_t stolen[8];
+            while (!done.load() || !deque.empty()) {
+                size_t count = deque.stealHalf(stolen, 8);
+                for (size_t j = 0; j < count; ++j) {
+                    taken[stolen[j]] += 1;
+                }
+            }
+        });
+    }
+
+    uint64_t value;
+    for (uint64_t i = 0; i < values; ++i) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(value)) {
+            taken[value] += 1;
+        }
+    }
+    while (deque.pop(value)) {
+        taken[value] += 1;
+    }
+
+    done.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (uint64_t i = 0; i < values; ++i) {
+        EXPECT_EQ(1, taken[i]);
+    }
+}